@@ -0,0 +1,86 @@
+#include "alloc_stats.h"
+#include <algorithm>
+
+#include <malloc.h>
+
+namespace
+{
+    thread_local bool accounting = false;
+    thread_local alloc_stats counters;
+
+    size_t histogram_bucket(size_t size)
+    {
+        size_t bucket = 0;
+        while (size != 0 && bucket + 1 != alloc_stats::histogram_size)
+        {
+            size >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+}
+
+alloc_stats const& alloc_stats::current()
+{
+    return counters;
+}
+
+bool alloc_stats::enabled()
+{
+    return accounting;
+}
+
+void alloc_stats::reset()
+{
+    counters = alloc_stats();
+}
+
+// Live bytes are tracked with malloc_usable_size so that unsized
+// operator delete can be accounted for.
+void alloc_stats::record_allocation(void* ptr, size_t size) noexcept
+{
+    if (!accounting)
+        return;
+
+    ++counters.allocations;
+    counters.bytes_allocated += size;
+    ++counters.size_histogram[histogram_bucket(size)];
+    counters.live_bytes += malloc_usable_size(ptr);
+    counters.peak_live_bytes = std::max(counters.peak_live_bytes, counters.live_bytes);
+}
+
+void alloc_stats::record_deallocation(void* ptr) noexcept
+{
+    if (!accounting || !ptr)
+        return;
+
+    ++counters.deallocations;
+    counters.live_bytes -= malloc_usable_size(ptr);
+}
+
+alloc_stats_scope::alloc_stats_scope()
+    : was_enabled(accounting)
+    , start(counters)
+{
+    counters.peak_live_bytes = counters.live_bytes;
+    accounting = true;
+}
+
+alloc_stats_scope::~alloc_stats_scope()
+{
+    accounting = was_enabled;
+    counters.peak_live_bytes = std::max(counters.peak_live_bytes, start.peak_live_bytes);
+}
+
+alloc_stats alloc_stats_scope::stats() const
+{
+    alloc_stats result;
+    result.allocations = counters.allocations - start.allocations;
+    result.deallocations = counters.deallocations - start.deallocations;
+    result.bytes_allocated = counters.bytes_allocated - start.bytes_allocated;
+    result.live_bytes = counters.live_bytes - start.live_bytes;
+    result.peak_live_bytes = counters.peak_live_bytes - start.live_bytes;
+    for (size_t i = 0; i != alloc_stats::histogram_size; ++i)
+        result.size_histogram[i] = counters.size_histogram[i] - start.size_histogram[i];
+    return result;
+}
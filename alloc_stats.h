@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+// Per-thread accounting of global operator new/delete calls.
+// The hooks are called from the replacement operators in fault_injection.cpp
+// and cost a call and a thread-local load while accounting is switched off.
+
+struct alloc_stats
+{
+    static constexpr size_t histogram_size = 48;
+
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t bytes_allocated = 0;
+    std::ptrdiff_t live_bytes = 0;
+    std::ptrdiff_t peak_live_bytes = 0;
+
+    // size_histogram[i] counts allocations of size in [2^(i-1), 2^i),
+    // size_histogram[0] counts zero-sized ones.
+    size_t size_histogram[histogram_size] = {};
+
+    static alloc_stats const& current();
+    static bool enabled();
+    static void reset();
+
+    static void record_allocation(void* ptr, size_t size) noexcept;
+    static void record_deallocation(void* ptr) noexcept;
+};
+
+// Enables accounting for the current thread and collects everything allocated
+// until destruction. Scopes nest; the outer scope sees the inner allocations.
+struct alloc_stats_scope
+{
+    alloc_stats_scope();
+    alloc_stats_scope(alloc_stats_scope const&) = delete;
+    alloc_stats_scope& operator=(alloc_stats_scope const&) = delete;
+    ~alloc_stats_scope();
+
+    alloc_stats stats() const;
+
+private:
+    bool was_enabled;
+    alloc_stats start;
+};
@@ -0,0 +1,237 @@
+#ifndef VECTOR_BLOCK_POOL_H
+#define VECTOR_BLOCK_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "vector.h"
+
+// Allocator for small heap blocks, with which vector opts in through
+// pooled_vector_policy:
+//
+//     vector<int, pooled_vector_policy> v;
+//
+// Blocks of up to max_pooled_size bytes are rounded up to a multiple of 16
+// and taken from a free list of that size class; larger ones go to operator
+// new. Each thread owns a heap of free lists, refilled by carving 64 KiB
+// slabs, each slab serving one size class. Allocation and freeing on the
+// owning thread are a few loads and stores, with no locks and no atomics.
+//
+// A slab is aligned to its size and starts with a pointer to its heap, so
+// freeing finds the owner by masking the address. A block freed by another
+// thread is pushed onto the owner's lock-free list of remote frees for its
+// class, which the owner takes over whole when its local list runs dry.
+//
+// Slabs are never returned to the system. The heap of an exited thread is
+// kept, with everything still allocated from it, and handed to the next
+// thread that allocates, so memory is bounded by the peak of concurrently
+// live blocks and threads. Blocks allocated by thread_local destructors that
+// run after the heap was handed back come from an idle heap, under the
+// registry lock.
+namespace pool_detail {
+    constexpr size_t granularity = 16;
+    constexpr size_t max_block = 512;
+    constexpr size_t classes = max_block / granularity;
+    constexpr size_t slab_size = 64 * 1024;
+    // keeps the blocks 16-byte aligned, like operator new's
+    constexpr size_t slab_header = 64;
+
+    constexpr size_t class_of(size_t size) noexcept {
+        return size == 0 ? 0 : (size - 1) / granularity;
+    }
+
+    struct free_block {
+        free_block *next;
+    };
+
+    struct heap;
+
+    struct slab {
+        heap *owner;
+        slab *next;
+    };
+
+    struct heap {
+        free_block *local[classes] = {};
+        std::atomic<free_block *> remote[classes] = {};
+        // the unused tail of the newest slab of each class
+        char *unused[classes] = {};
+        char *unused_end[classes] = {};
+        slab *slabs = nullptr;
+        size_t slab_count = 0;
+        // guarded by the registry mutex
+        bool in_use = false;
+        heap *next = nullptr;
+
+        void *allocate(size_t c) {
+            free_block *b = local[c];
+            if (b == nullptr) {
+                b = remote[c].exchange(nullptr, std::memory_order_acquire);
+                if (b == nullptr) {
+                    return carve(c);
+                }
+            }
+            local[c] = b->next;
+            return b;
+        }
+
+        void *carve(size_t c) {
+            size_t size = (c + 1) * granularity;
+            if (static_cast<size_t>(unused_end[c] - unused[c]) < size) {
+                auto s = static_cast<slab *>(operator new(slab_size, std::align_val_t(slab_size)));
+                s->owner = this;
+                s->next = slabs;
+                slabs = s;
+                slab_count++;
+                unused[c] = reinterpret_cast<char *>(s) + slab_header;
+                unused_end[c] = reinterpret_cast<char *>(s) + slab_size;
+            }
+            void *result = unused[c];
+            unused[c] += size;
+            return result;
+        }
+    };
+
+    // Heaps live as long as the process, reachable from here.
+    struct registry {
+        std::mutex mutex;
+        heap *heaps = nullptr;
+
+        static registry &instance() {
+            static registry *r = new registry;
+            return *r;
+        }
+
+        heap *acquire() {
+            std::lock_guard<std::mutex> lock(mutex);
+            heap *h = heaps;
+            while (h != nullptr && h->in_use) {
+                h = h->next;
+            }
+            if (h == nullptr) {
+                h = new heap;
+                h->next = heaps;
+                heaps = h;
+            }
+            h->in_use = true;
+            return h;
+        }
+
+        void release(heap *h) noexcept {
+            std::lock_guard<std::mutex> lock(mutex);
+            h->in_use = false;
+        }
+    };
+
+    // The calling thread's heap, or nullptr before its first allocation
+    // and after its exit.
+    inline heap *&current() noexcept {
+        thread_local heap *h = nullptr;
+        return h;
+    }
+
+    // Set once the calling thread has handed its heap back; trivially
+    // destructible, so that it can be read by later thread_local destructors.
+    inline bool &exited() noexcept {
+        thread_local bool e = false;
+        return e;
+    }
+
+    struct thread_heap {
+        heap *h;
+
+        thread_heap() : h(registry::instance().acquire()) {
+            current() = h;
+        }
+
+        ~thread_heap() {
+            current() = nullptr;
+            exited() = true;
+            registry::instance().release(h);
+        }
+    };
+
+    inline heap &local_heap() {
+        thread_local thread_heap handle;
+        return *handle.h;
+    }
+
+    inline void *allocate(size_t c) {
+        if (heap *h = current()) {
+            return h->allocate(c);
+        }
+        if (!exited()) {
+            return local_heap().allocate(c);
+        }
+        // A thread_local destructor running after the thread's heap is gone
+        // borrows an idle heap for this one block, which is then freed to it
+        // as a remote free.
+        registry &r = registry::instance();
+        heap *h = r.acquire();
+        void *result;
+        try {
+            result = h->allocate(c);
+        } catch (...) {
+            r.release(h);
+            throw;
+        }
+        r.release(h);
+        return result;
+    }
+
+    inline heap *owner_of(void *block) noexcept {
+        auto address = reinterpret_cast<std::uintptr_t>(block);
+        return reinterpret_cast<slab *>(address & ~static_cast<std::uintptr_t>(slab_size - 1))->owner;
+    }
+}
+
+struct block_pool {
+    static constexpr size_t max_pooled_size = pool_detail::max_block;
+
+    static void *allocate(size_t size) {
+        if (size > max_pooled_size) {
+            return operator new(size);
+        }
+        return pool_detail::allocate(pool_detail::class_of(size));
+    }
+
+    // `size` must be the one passed to allocate.
+    static void deallocate(void *block, size_t size) noexcept {
+        if (size > max_pooled_size) {
+            operator delete(block);
+            return;
+        }
+        size_t c = pool_detail::class_of(size);
+        auto b = static_cast<pool_detail::free_block *>(block);
+        pool_detail::heap *owner = pool_detail::owner_of(block);
+        if (owner == pool_detail::current()) {
+            b->next = owner->local[c];
+            owner->local[c] = b;
+            return;
+        }
+        b->next = owner->remote[c].load(std::memory_order_relaxed);
+        while (!owner->remote[c].compare_exchange_weak(b->next, b, std::memory_order_release,
+                                                       std::memory_order_relaxed)) {
+        }
+    }
+
+    // Slabs carved by the calling thread's heap so far; 0 after its exit.
+    static size_t thread_slab_count() {
+        return pool_detail::exited() ? 0 : pool_detail::local_heap().slab_count;
+    }
+};
+
+struct pooled_vector_policy : default_vector_policy {
+    static void *allocate_block(size_t size) {
+        return block_pool::allocate(size);
+    }
+
+    static void deallocate_block(void *block, size_t size) noexcept {
+        block_pool::deallocate(block, size);
+    }
+};
+
+#endif //VECTOR_BLOCK_POOL_H
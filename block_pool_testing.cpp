@@ -0,0 +1,218 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "block_pool.h"
+#include "counted.h"
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+#include "no_alloc.h"
+
+typedef vector<int, pooled_vector_policy> pooled_vector;
+
+TEST(block_pool, reuses_freed_blocks)
+{
+    void* a = block_pool::allocate(40);
+    void* b = block_pool::allocate(48);
+    void* c = block_pool::allocate(49);
+    EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(a) % 16);
+    EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(c) % 16);
+    EXPECT_NE(a, b);
+
+    block_pool::deallocate(a, 40);
+    // same size class
+    EXPECT_EQ(a, block_pool::allocate(33));
+    block_pool::deallocate(c, 49);
+    EXPECT_EQ(c, block_pool::allocate(64));
+    block_pool::deallocate(a, 33);
+    block_pool::deallocate(b, 48);
+    block_pool::deallocate(c, 64);
+}
+
+TEST(block_pool, large_blocks_use_operator_new)
+{
+    alloc_stats_scope s;
+    void* p = block_pool::allocate(block_pool::max_pooled_size + 1);
+    block_pool::deallocate(p, block_pool::max_pooled_size + 1);
+    EXPECT_EQ(1u, s.stats().allocations);
+    EXPECT_EQ(1u, s.stats().deallocations);
+}
+
+TEST(block_pool, churn_stays_in_its_slabs)
+{
+    auto round_trip = [](int round)
+    {
+        pooled_vector v;
+        for (int i = 0; i != 8; ++i)
+            v.push_back(i);
+        pooled_vector copy = v;
+        copy[0] = round;
+        EXPECT_EQ(round, copy[0]);
+        EXPECT_EQ(0, v[0]);
+    };
+    // carves the slabs of capacities 2, 4 and 8 if needed
+    round_trip(0);
+    size_t slabs = block_pool::thread_slab_count();
+    alloc_stats_scope s;
+    for (int round = 1; round != 10000; ++round)
+        round_trip(round);
+    EXPECT_EQ(slabs, block_pool::thread_slab_count());
+    EXPECT_EQ(0u, s.stats().allocations);
+}
+
+TEST(block_pool, slab_refill_is_an_allocation)
+{
+    size_t slabs = block_pool::thread_slab_count();
+    std::vector<void*> blocks;
+    blocks.reserve(2 * pool_detail::slab_size / block_pool::max_pooled_size);
+    {
+        alloc_stats_scope s;
+        no_alloc_scope scope(no_alloc_scope::action::log);
+        while (block_pool::thread_slab_count() == slabs)
+            blocks.push_back(block_pool::allocate(block_pool::max_pooled_size));
+        EXPECT_EQ(1u, scope.violations());
+        EXPECT_EQ(1u, s.stats().allocations);
+        EXPECT_LE(pool_detail::slab_size, s.stats().bytes_allocated);
+    }
+    for (void* b : blocks)
+        block_pool::deallocate(b, block_pool::max_pooled_size);
+}
+
+TEST(block_pool, remote_free_returns_to_owner)
+{
+    std::atomic<void*> block{nullptr};
+    std::atomic<bool> freed{false};
+    bool found = false;
+    std::thread owner([&]
+                      {
+                          block = block_pool::allocate(100);
+                          while (!freed)
+                              std::this_thread::yield();
+                          // a reused heap may hold local free blocks of this
+                          // class; the remote ones come after them
+                          std::vector<void*> taken;
+                          while (!found && taken.size() != 100000)
+                          {
+                              taken.push_back(block_pool::allocate(100));
+                              found = taken.back() == block;
+                          }
+                          for (void* p : taken)
+                              block_pool::deallocate(p, 100);
+                      });
+    while (block == nullptr)
+        std::this_thread::yield();
+    block_pool::deallocate(block, 100);
+    freed = true;
+    owner.join();
+    EXPECT_TRUE(found);
+}
+
+TEST(block_pool, vectors_cross_threads)
+{
+    pooled_vector shared;
+    for (int i = 0; i != 100; ++i)
+        shared.push_back(i);
+
+    pooled_vector from_thread;
+    std::thread t([&]
+                  {
+                      pooled_vector local = shared;
+                      local.push_back(100);
+                      pooled_vector small;
+                      small.push_back(1);
+                      small.push_back(2);
+                      from_thread = small;
+                  });
+    t.join();
+    // the thread's heap outlives it; its blocks are freed here
+    EXPECT_EQ(2u, from_thread.size());
+    EXPECT_EQ(2, from_thread[1]);
+    from_thread = pooled_vector();
+    EXPECT_EQ(100u, shared.size());
+}
+
+namespace
+{
+    pooled_vector left_at_exit;
+    size_t slabs_at_exit = 1;
+
+    // Allocates from its destructor, which runs after the thread has handed
+    // its heap back when the instance is made before the first allocation.
+    struct allocates_at_exit
+    {
+        ~allocates_at_exit()
+        {
+            pooled_vector v;
+            for (int i = 0; i != 10; ++i)
+                v.push_back(i);
+            pooled_vector copy = v;
+            copy.push_back(10);
+            left_at_exit = copy;
+            slabs_at_exit = block_pool::thread_slab_count();
+        }
+    };
+}
+
+TEST(block_pool, allocation_from_thread_local_destructor)
+{
+    std::thread t([]
+                  {
+                      thread_local allocates_at_exit a;
+                      (void)a;
+                      pooled_vector v;
+                      v.push_back(1);
+                      EXPECT_LT(0u, block_pool::thread_slab_count());
+                  });
+    t.join();
+    EXPECT_EQ(0u, slabs_at_exit);
+    ASSERT_EQ(11u, left_at_exit.size());
+    for (int i = 0; i != 11; ++i)
+        EXPECT_EQ(i, left_at_exit[i]);
+    left_at_exit = pooled_vector();
+}
+
+TEST(block_pool, exception_safety)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   vector<counted, pooled_vector_policy> v;
+                   for (int i = 0; i != 6; ++i)
+                       v.push_back(i);
+                   vector<counted, pooled_vector_policy> copy = v;
+                   copy.insert(copy.begin() + 2, 10);
+                   copy.erase(copy.begin());
+                   EXPECT_EQ(6u, copy.size());
+                   EXPECT_EQ(10, copy[1]);
+               });
+}
+
+TEST(block_pool, failed_slab_refill)
+{
+    std::atomic<size_t> runs(0);
+    faulty_run([&]
+               {
+                   runs++;
+                   std::vector<void*> blocks;
+                   blocks.reserve(2 * pool_detail::slab_size / block_pool::max_pooled_size);
+                   size_t slabs = block_pool::thread_slab_count();
+                   try
+                   {
+                       while (block_pool::thread_slab_count() == slabs)
+                           blocks.push_back(block_pool::allocate(block_pool::max_pooled_size));
+                   }
+                   catch (...)
+                   {
+                       EXPECT_EQ(slabs, block_pool::thread_slab_count());
+                       for (void* b : blocks)
+                           block_pool::deallocate(b, block_pool::max_pooled_size);
+                       throw;
+                   }
+                   for (void* b : blocks)
+                       block_pool::deallocate(b, block_pool::max_pooled_size);
+               }, fault_filter::allocations_of_at_least(pool_detail::slab_size));
+    // the refill faults once, then succeeds
+    EXPECT_EQ(2u, runs.load());
+}
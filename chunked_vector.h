@@ -0,0 +1,237 @@
+#ifndef VECTOR_CHUNKED_VECTOR_H
+#define VECTOR_CHUNKED_VECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "indexed_iterator.h"
+#include "vector.h"
+
+// Vector stored as fixed-size chunks, each shared copy-on-write on its own.
+//
+// A directory of chunk pointers keeps operator[] and the iterators O(1): the
+// chunk of element i is i / chunk_size, a power of two of elements that fits
+// in ChunkBytes. Every chunk has its own reference count, so after a copy the
+// first write to an element copies that chunk only, rather than the whole
+// buffer as vector's copy_if_necessary does. Copying the vector itself
+// copies the directory and bumps the count of every chunk.
+//
+// The elements are not contiguous; flatten() copies them into a vector.
+template<typename T, size_t ChunkBytes = 64 * 1024>
+class chunked_vector {
+    static constexpr size_t floor_pow2(size_t n) {
+        size_t result = 1;
+        while (result * 2 <= n) {
+            result *= 2;
+        }
+        return result;
+    }
+
+public:
+    typedef T value_type;
+    typedef T &reference;
+    typedef T const &const_reference;
+
+    static constexpr size_t chunk_size = floor_pow2(std::max<size_t>(1, ChunkBytes / sizeof(T)));
+
+    typedef indexed_const_iterator<chunked_vector, T> const_iterator;
+    chunked_vector() noexcept = default;
+
+    explicit chunked_vector(vector<T> const &v) {
+        chunks.reserve((v.size() + chunk_size - 1) / chunk_size);
+        try {
+            for (T const *p = v.data(), *last = p + v.size(); p != last; ++p) {
+                push_back(*p);
+            }
+        } catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    chunked_vector(chunked_vector const &other) : chunks(other.chunks), count(other.count) {
+        for (info_pointer chunk : chunks) {
+            refs(chunk)++;
+        }
+    }
+
+    chunked_vector &operator=(chunked_vector const &other) {
+        if (this != &other) {
+            chunked_vector copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    ~chunked_vector() {
+        clear();
+    }
+
+    void swap(chunked_vector &other) noexcept {
+        chunks.swap(other.chunks);
+        std::swap(count, other.count);
+    }
+
+    size_t size() const noexcept {
+        return count;
+    }
+
+    bool empty() const noexcept {
+        return count == 0;
+    }
+
+    size_t chunk_count() const noexcept {
+        return chunks.size();
+    }
+
+    const_reference operator[](size_t i) const noexcept {
+        return data(chunks[i / chunk_size])[i % chunk_size];
+    }
+
+    // Mutable access detaches the element's chunk, like vector's operator[].
+    reference operator[](size_t i) {
+        return data(unique_chunk(i / chunk_size))[i % chunk_size];
+    }
+
+    const_reference back() const noexcept {
+        return (*this)[count - 1];
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(this, count);
+    }
+
+    void push_back(const_reference value) {
+        size_t offset = count % chunk_size;
+        if (offset != 0) {
+            new(data(unique_chunk(chunks.size() - 1)) + offset) T(value);
+            count++;
+            return;
+        }
+        chunks.reserve(chunks.size() + 1);
+        info_pointer chunk = allocate_chunk();
+        try {
+            new(data(chunk)) T(value);
+        } catch (...) {
+            operator delete(static_cast<void *>(chunk));
+            throw;
+        }
+        chunks.push_back(chunk);
+        count++;
+    }
+
+    void pop_back() {
+        assert(count != 0);
+        size_t last = chunks.size() - 1;
+        if (count % chunk_size == 1 || chunk_size == 1) {
+            release(chunks[last], 1);
+            chunks.pop_back();
+        } else {
+            std::destroy_at(data(unique_chunk(last)) + (count - 1) % chunk_size);
+        }
+        count--;
+    }
+
+    void clear() noexcept {
+        for (size_t k = 0; k != chunks.size(); ++k) {
+            release(chunks[k], elements_in(k));
+        }
+        chunks.clear();
+        count = 0;
+    }
+
+    // Calls f(data, size) for each chunk in order.
+    template<typename F>
+    void for_each_chunk(F f) const {
+        for (size_t k = 0; k != chunks.size(); ++k) {
+            f(static_cast<T const *>(data(chunks[k])), elements_in(k));
+        }
+    }
+
+    // Contiguous copy of the elements, made with one allocation.
+    vector<T> flatten() const {
+        vector<T> result;
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            result.overwrite(count, [this](T *out) {
+                for_each_chunk([&out](T const *p, size_t n) {
+                    std::memcpy(static_cast<void *>(out), p, n * sizeof(T));
+                    out += n;
+                });
+            });
+        } else {
+            result.reserve(count);
+            for_each_chunk([&result](T const *p, size_t n) {
+                for (size_t i = 0; i != n; ++i) {
+                    result.push_back(p[i]);
+                }
+            });
+        }
+        return result;
+    }
+
+private:
+    // A chunk is a reference count followed by up to chunk_size elements.
+    typedef char *info_pointer;
+
+    static constexpr size_t header = std::max(sizeof(size_t), alignof(T));
+
+    static size_t &refs(info_pointer chunk) noexcept {
+        return *reinterpret_cast<size_t *>(chunk);
+    }
+
+    static T *data(info_pointer chunk) noexcept {
+        return std::launder(reinterpret_cast<T *>(chunk + header));
+    }
+
+    size_t elements_in(size_t k) const noexcept {
+        return std::min(chunk_size, count - k * chunk_size);
+    }
+
+    static info_pointer allocate_chunk() {
+        auto chunk = static_cast<info_pointer>(operator new(header + chunk_size * sizeof(T)));
+        refs(chunk) = 1;
+        return chunk;
+    }
+
+    static void release(info_pointer chunk, size_t n) noexcept {
+        if (--refs(chunk) == 0) {
+            std::destroy(data(chunk), data(chunk) + n);
+            operator delete(static_cast<void *>(chunk));
+        }
+    }
+
+    // Copies chunk k if another vector shares it.
+    info_pointer unique_chunk(size_t k) {
+        info_pointer chunk = chunks[k];
+        if (refs(chunk) == 1) {
+            return chunk;
+        }
+        size_t n = elements_in(k);
+        info_pointer copy = allocate_chunk();
+        try {
+            std::uninitialized_copy(data(chunk), data(chunk) + n, data(copy));
+        } catch (...) {
+            operator delete(static_cast<void *>(copy));
+            throw;
+        }
+        refs(chunk)--;
+        chunks[k] = copy;
+        return copy;
+    }
+
+    std::vector<info_pointer> chunks;
+    size_t count = 0;
+};
+
+#endif //VECTOR_CHUNKED_VECTOR_H
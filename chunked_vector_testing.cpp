@@ -0,0 +1,123 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "chunked_vector.h"
+#include "counted.h"
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+
+namespace
+{
+    // chunks of 16 ints
+    typedef chunked_vector<int, 64> small_chunks;
+}
+
+TEST(chunked_vector, chunk_size)
+{
+    EXPECT_EQ(16384u, (chunked_vector<int>::chunk_size));
+    EXPECT_EQ(16u, small_chunks::chunk_size);
+    EXPECT_EQ(2u, (chunked_vector<char[24], 64>::chunk_size));
+    EXPECT_EQ(1u, (chunked_vector<char[100], 64>::chunk_size));
+}
+
+TEST(chunked_vector, push_back_and_pop_back)
+{
+    small_chunks c;
+    std::vector<int> expected;
+    for (int i = 0; i != 1000; ++i)
+    {
+        c.push_back(i);
+        expected.push_back(i);
+    }
+    EXPECT_EQ(63u, c.chunk_count());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), c.begin(), c.end()));
+    EXPECT_EQ(1000, c.end() - c.begin());
+    EXPECT_EQ(500, c.begin()[500]);
+
+    while (!c.empty())
+    {
+        c.pop_back();
+        expected.pop_back();
+        ASSERT_EQ(expected.size(), c.size());
+        ASSERT_EQ((expected.size() + 15) / 16, c.chunk_count());
+        if (!expected.empty())
+        {
+            ASSERT_EQ(expected.back(), c.back());
+        }
+    }
+}
+
+TEST(chunked_vector, write_copies_one_chunk)
+{
+    small_chunks c;
+    for (int i = 0; i != 1000; ++i)
+        c.push_back(i);
+    small_chunks d = c;
+
+    alloc_stats_scope s;
+    d[500] = -1;
+    EXPECT_EQ(1u, s.stats().allocations);
+    EXPECT_EQ(500, std::as_const(c)[500]);
+    EXPECT_EQ(-1, std::as_const(d)[500]);
+    // the neighbouring chunks are still shared
+    EXPECT_EQ(&std::as_const(c)[480], &std::as_const(d)[480]);
+    EXPECT_NE(&std::as_const(c)[496], &std::as_const(d)[496]);
+    EXPECT_EQ(&std::as_const(c)[512], &std::as_const(d)[512]);
+
+    // d copies the last chunk, after which c owns its own alone
+    d[501] = -2;
+    d.push_back(1000);
+    c.push_back(2000);
+    EXPECT_EQ(2u, s.stats().allocations);
+    EXPECT_EQ(1000, d.back());
+    EXPECT_EQ(2000, c.back());
+}
+
+TEST(chunked_vector, flatten)
+{
+    vector<int> numbers;
+    for (int i = 0; i != 100; ++i)
+        numbers.push_back(i);
+    small_chunks c(numbers);
+    alloc_stats_scope s;
+    EXPECT_EQ(numbers, c.flatten());
+    EXPECT_EQ(1u, s.stats().allocations);
+
+    vector<std::string> words;
+    for (int i = 0; i != 20; ++i)
+        words.push_back(std::to_string(i));
+    EXPECT_EQ(words, (chunked_vector<std::string, 128>(words).flatten()));
+}
+
+TEST(chunked_vector, strong_guarantee)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   chunked_vector<counted, 4 * sizeof(counted)> c;
+                   for (int i = 0; i != 10; ++i)
+                       c.push_back(i);
+                   chunked_vector<counted, 4 * sizeof(counted)> d = c;
+                   try
+                   {
+                       d[5] = -5;
+                       d.pop_back();
+                       d.pop_back();
+                       d.push_back(100);
+                       d.push_back(101);
+                       d.push_back(102);
+                       EXPECT_EQ(-5, std::as_const(d)[5]);
+                       EXPECT_EQ(102, d.back());
+                       EXPECT_EQ(11u, d.size());
+                   }
+                   catch (...)
+                   {
+                       ASSERT_EQ(10u, c.size());
+                       for (int i = 0; i != 10; ++i)
+                           ASSERT_EQ(i, std::as_const(c)[i]);
+                       throw;
+                   }
+               });
+}
@@ -0,0 +1,197 @@
+#ifndef VECTOR_CONCURRENT_VECTOR_H
+#define VECTOR_CONCURRENT_VECTOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#include "vector.h"
+
+// Append-only vector for many concurrent writers and rare readers.
+//
+// push_back makes sure the segment of the next slot exists, reserves the
+// slot with a compare-and-swap on the slot counter and constructs the element
+// in place. Storage grows through segments of doubling capacity that are
+// never moved or freed before destruction, so a published element keeps its
+// address. Each slot carries a state byte that is set with release semantics
+// once the element is constructed; readers only look at the contiguous prefix
+// of settled slots.
+//
+// If allocating a segment throws, no slot is reserved. If a copy constructor
+// throws, its slot is marked abandoned: size() counts it, published() is
+// false for it and snapshot() skips it, and later elements stay readable.
+template<typename T>
+class concurrent_vector {
+public:
+    typedef T value_type;
+    typedef T const &const_reference;
+
+    concurrent_vector() noexcept = default;
+
+    concurrent_vector(concurrent_vector const &) = delete;
+
+    concurrent_vector &operator=(concurrent_vector const &) = delete;
+
+    // Not thread-safe: no push_back may run concurrently.
+    ~concurrent_vector() {
+        for (size_t k = 0; k != max_segments; ++k) {
+            info_pointer seg = segments[k].load(std::memory_order_relaxed);
+            if (seg == nullptr) {
+                continue;
+            }
+            size_t cap = segment_capacity(k);
+            for (size_t i = 0; i != cap; ++i) {
+                if (states(seg)[i].load(std::memory_order_relaxed) == published_slot) {
+                    std::destroy_at(data(seg, cap) + i);
+                }
+            }
+            operator delete(static_cast<void *>(seg));
+        }
+    }
+
+    // Returns the index of the new element.
+    size_t push_back(const_reference value) {
+        size_t index = reserved.load(std::memory_order_relaxed);
+        info_pointer seg;
+        do {
+            seg = get_segment(segment_of(index));
+        } while (!reserved.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+        size_t k = segment_of(index);
+        size_t offset = index - segment_start(k);
+        size_t cap = segment_capacity(k);
+        try {
+            new(data(seg, cap) + offset) value_type(value);
+        } catch (...) {
+            states(seg)[offset].store(abandoned_slot, std::memory_order_release);
+            throw;
+        }
+        states(seg)[offset].store(published_slot, std::memory_order_release);
+        return index;
+    }
+
+    // Number of slots handed out so far, published or not.
+    size_t reserved_size() const noexcept {
+        return reserved.load(std::memory_order_relaxed);
+    }
+
+    // Length of the contiguous prefix of published or abandoned slots.
+    size_t size() const noexcept {
+        size_t n = settled_prefix.load(std::memory_order_relaxed);
+        size_t limit = reserved.load(std::memory_order_acquire);
+        while (n < limit && state(n) != empty_slot) {
+            ++n;
+        }
+        size_t cached = settled_prefix.load(std::memory_order_relaxed);
+        while (cached < n && !settled_prefix.compare_exchange_weak(cached, n, std::memory_order_relaxed)) {
+        }
+        return n;
+    }
+
+    // Whether slot i < size() holds an element, rather than one whose copy
+    // constructor threw.
+    bool published(size_t i) const noexcept {
+        return state(i) == published_slot;
+    }
+
+    // Requires i < size() and published(i).
+    const_reference operator[](size_t i) const noexcept {
+        size_t k = segment_of(i);
+        info_pointer seg = segments[k].load(std::memory_order_acquire);
+        return data(seg, segment_capacity(k))[i - segment_start(k)];
+    }
+
+    // Copies every published element, skipping abandoned slots and stopping at
+    // the first slot that is still being written.
+    vector<T> snapshot() const {
+        size_t limit = reserved.load(std::memory_order_acquire);
+        vector<T> result;
+        result.reserve(limit);
+        for (size_t i = 0; i != limit; ++i) {
+            unsigned char s = state(i);
+            if (s == abandoned_slot) {
+                continue;
+            }
+            if (s != published_slot) {
+                break;
+            }
+            result.push_back((*this)[i]);
+        }
+        return result;
+    }
+
+private:
+    typedef char *info_pointer;
+
+    static constexpr unsigned char empty_slot = 0;
+    static constexpr unsigned char published_slot = 1;
+    static constexpr unsigned char abandoned_slot = 2;
+
+    static constexpr size_t first_segment_capacity = 8;
+    static constexpr size_t max_segments = 8 * sizeof(size_t) - 3;
+
+    std::atomic<size_t> reserved{0};
+    mutable std::atomic<size_t> settled_prefix{0};
+    std::atomic<info_pointer> segments[max_segments] = {};
+
+    // Segment k holds first_segment_capacity << k slots starting at
+    // first_segment_capacity * (2^k - 1).
+    static size_t segment_of(size_t index) noexcept {
+        size_t x = index / first_segment_capacity + 1;
+        size_t k = 0;
+        while (x >>= 1) {
+            ++k;
+        }
+        return k;
+    }
+
+    static size_t segment_start(size_t k) noexcept {
+        return first_segment_capacity * ((size_t(1) << k) - 1);
+    }
+
+    static size_t segment_capacity(size_t k) noexcept {
+        return first_segment_capacity << k;
+    }
+
+    // A segment is one block: slot states, padding to alignof(T), elements.
+    static size_t data_offset(size_t cap) noexcept {
+        return (cap + alignof(value_type) - 1) / alignof(value_type) * alignof(value_type);
+    }
+
+    static std::atomic<unsigned char> *states(info_pointer seg) noexcept {
+        return reinterpret_cast<std::atomic<unsigned char> *>(seg);
+    }
+
+    static value_type *data(info_pointer seg, size_t cap) noexcept {
+        return reinterpret_cast<value_type *>(seg + data_offset(cap));
+    }
+
+    unsigned char state(size_t index) const noexcept {
+        size_t k = segment_of(index);
+        info_pointer seg = segments[k].load(std::memory_order_acquire);
+        if (seg == nullptr) {
+            return empty_slot;
+        }
+        return states(seg)[index - segment_start(k)].load(std::memory_order_acquire);
+    }
+
+    info_pointer get_segment(size_t k) {
+        info_pointer seg = segments[k].load(std::memory_order_acquire);
+        if (seg != nullptr) {
+            return seg;
+        }
+        size_t cap = segment_capacity(k);
+        static_assert(alignof(value_type) <= alignof(std::max_align_t), "over-aligned types are not supported");
+        auto fresh = static_cast<info_pointer>(operator new(data_offset(cap) + cap * sizeof(value_type)));
+        for (size_t i = 0; i != cap; ++i) {
+            new(states(fresh) + i) std::atomic<unsigned char>(empty_slot);
+        }
+        if (segments[k].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+            return fresh;
+        }
+        operator delete(static_cast<void *>(fresh));
+        return seg;
+    }
+};
+
+#endif //VECTOR_CONCURRENT_VECTOR_H
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "concurrent_vector.h"
+#include "counted.h"
+#include "fault_injection.h"
+
+TEST(concurrent_vector, push_back_single_thread)
+{
+    concurrent_vector<std::string> c;
+    for (size_t i = 0; i != 100; ++i)
+        EXPECT_EQ(i, c.push_back(std::to_string(i)));
+
+    EXPECT_EQ(100u, c.size());
+    for (size_t i = 0; i != 100; ++i)
+        EXPECT_EQ(std::to_string(i), c[i]);
+
+    vector<std::string> s = c.snapshot();
+    EXPECT_EQ(100u, s.size());
+    EXPECT_EQ("99", s[99]);
+}
+
+TEST(concurrent_vector, concurrent_push_back)
+{
+    const int threads = 8;
+    const int per_thread = 20000;
+    concurrent_vector<int> c;
+    std::atomic<bool> done(false);
+
+    std::thread reader([&]
+                       {
+                           while (!done)
+                           {
+                               vector<int> s = c.snapshot();
+                               EXPECT_LE(s.size(), c.reserved_size());
+                               for (size_t i = 0; i != s.size(); ++i)
+                                   EXPECT_EQ(s[i], c[i]);
+                           }
+                       });
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t != threads; ++t)
+        writers.emplace_back([&c, t]
+                             {
+                                 for (int i = 0; i != per_thread; ++i)
+                                     c.push_back(t * per_thread + i);
+                             });
+    for (auto& w : writers)
+        w.join();
+    done = true;
+    reader.join();
+
+    vector<int> s = c.snapshot();
+    ASSERT_EQ(static_cast<size_t>(threads * per_thread), s.size());
+    std::vector<int> values(s.begin(), s.end());
+    std::sort(values.begin(), values.end());
+    for (int i = 0; i != threads * per_thread; ++i)
+        EXPECT_EQ(i, values[i]);
+}
+
+TEST(concurrent_vector, failed_segment_allocation)
+{
+    faulty_run([]
+               {
+                   concurrent_vector<int> c;
+                   try
+                   {
+                       for (int i = 0; i != 100; ++i)
+                           c.push_back(i);
+                   }
+                   catch (...)
+                   {
+                       fault_injection_disable dg;
+                       // the failed push_back reserved nothing
+                       EXPECT_EQ(c.reserved_size(), c.size());
+                       for (int i = static_cast<int>(c.size()); i != 100; ++i)
+                           EXPECT_EQ(static_cast<size_t>(i), c.push_back(i));
+                       EXPECT_EQ(100u, c.size());
+                       for (int i = 0; i != 100; ++i)
+                           EXPECT_EQ(i, c[i]);
+                       EXPECT_EQ(100u, c.snapshot().size());
+                       throw;
+                   }
+               });
+}
+
+TEST(concurrent_vector, throwing_copy_abandons_one_slot)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   concurrent_vector<counted> c;
+                   try
+                   {
+                       for (int i = 0; i != 20; ++i)
+                           c.push_back(counted(i));
+                   }
+                   catch (...)
+                   {
+                       fault_injection_disable dg;
+                       size_t failed = c.reserved_size() - 1;
+                       for (int i = static_cast<int>(failed) + 1; i != 20; ++i)
+                           c.push_back(counted(i));
+                       EXPECT_EQ(20u, c.size());
+                       EXPECT_FALSE(c.published(failed));
+                       for (size_t i = 0; i != 20; ++i)
+                           if (i != failed)
+                           {
+                               EXPECT_TRUE(c.published(i));
+                               EXPECT_EQ(static_cast<int>(i), c[i]);
+                           }
+                       vector<counted> s = c.snapshot();
+                       EXPECT_EQ(19u, s.size());
+                       for (size_t i = 0; i != s.size(); ++i)
+                           EXPECT_EQ(static_cast<int>(i < failed ? i : i + 1), s[i]);
+                       throw;
+                   }
+               }, fault_filter::only_sites({counted::copy_site}));
+}
@@ -1,8 +1,11 @@
 #include "counted.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 
 #include "fault_injection.h"
+#include "mmap_allocator.h"
 
 namespace
 {
@@ -10,70 +13,194 @@ namespace
     {
         return data ^ static_cast<int>(reinterpret_cast<std::ptrdiff_t>(ptr) / sizeof(counted));
     }
+
+    std::string schedule_note()
+    {
+        return "fault schedule: \"" + current_fault_schedule() + "\"";
+    }
+
+    size_t mix(counted const* ptr)
+    {
+        auto h = static_cast<uint64_t>(reinterpret_cast<std::uintptr_t>(ptr));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
 }
 
+// Open-addressing set of live instances with linear probing and
+// backward-shift deletion. Its storage comes from mmap_allocator, so it
+// neither hits fault injection points nor shows up in alloc_stats.
+// The checksum is an xor of the hashes of all members, which lets
+// no_new_instances_guard compare snapshots in O(1).
+struct counted::instance_set
+{
+    instance_set() = default;
+    instance_set(instance_set const&) = delete;
+    instance_set& operator=(instance_set const&) = delete;
+
+    ~instance_set()
+    {
+        if (slots)
+            mmap_allocator<counted const*>().deallocate(slots, capacity);
+    }
+
+    bool insert(counted const* ptr)
+    {
+        if (2 * (count + 1) > capacity)
+            grow();
+        size_t i = find_slot(ptr);
+        if (slots[i] == ptr)
+            return false;
+        slots[i] = ptr;
+        ++count;
+        checksum ^= mix(ptr);
+        return true;
+    }
+
+    bool contains(counted const* ptr) const
+    {
+        return capacity != 0 && slots[find_slot(ptr)] == ptr;
+    }
+
+    size_t erase(counted const* ptr)
+    {
+        if (capacity == 0)
+            return 0;
+        size_t i = find_slot(ptr);
+        if (slots[i] != ptr)
+            return 0;
+
+        size_t mask = capacity - 1;
+        for (size_t j = (i + 1) & mask; slots[j]; j = (j + 1) & mask)
+        {
+            size_t home = mix(slots[j]) & mask;
+            // move slots[j] into the hole unless its home lies in (i, j]
+            if (((j - home) & mask) >= ((j - i) & mask))
+            {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = nullptr;
+        --count;
+        checksum ^= mix(ptr);
+        return 1;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t hash() const
+    {
+        return checksum;
+    }
+
+private:
+    size_t find_slot(counted const* ptr) const
+    {
+        size_t mask = capacity - 1;
+        size_t i = mix(ptr) & mask;
+        while (slots[i] && slots[i] != ptr)
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    void grow()
+    {
+        mmap_allocator<counted const*> allocator;
+        counted const** old_slots = slots;
+        size_t old_capacity = capacity;
+
+        capacity = old_capacity ? 2 * old_capacity : 1024;
+        slots = allocator.allocate(capacity);
+        std::fill(slots, slots + capacity, nullptr);
+        for (size_t i = 0; i != old_capacity; ++i)
+            if (old_slots[i])
+                slots[find_slot(old_slots[i])] = old_slots[i];
+
+        if (old_slots)
+            allocator.deallocate(old_slots, old_capacity);
+    }
+
+    counted const** slots = nullptr;
+    size_t capacity = 0;
+    size_t count = 0;
+    size_t checksum = 0;
+};
+
 counted::counted(int data)
     : data(transcode(data, this))
 {
-    fault_injection_point();
+    fault_injection_point(construction_site);
     fault_injection_disable fd;
-    auto p = instances.insert(this);
-    EXPECT_TRUE(p.second);
+    EXPECT_TRUE(instances.insert(this)) << schedule_note();
 }
 
 counted::counted(counted const& other)
 {
-    fault_injection_point();
+    fault_injection_point(copy_site);
     {
         fault_injection_disable fd;
-        EXPECT_TRUE(instances.find(&other) != instances.end());
-        auto p = instances.insert(this);
-        EXPECT_TRUE(p.second);
+        EXPECT_TRUE(instances.contains(&other)) << schedule_note();
+        EXPECT_TRUE(instances.insert(this)) << schedule_note();
     }
     data = transcode(transcode(other.data, &other), this);
+    ++copy_constructions;
 }
 
 counted::~counted()
 {
     fault_injection_disable fd;
     size_t n = instances.erase(this);
-    EXPECT_EQ(1u, n);
+    EXPECT_EQ(1u, n) << schedule_note();
+    ++destructions;
 }
 
 counted& counted::operator=(counted const& c)
 {
-    fault_injection_point();
+    fault_injection_point(assignment_site);
     {
         fault_injection_disable fd;
-        EXPECT_TRUE(instances.find(this) != instances.end());
+        EXPECT_TRUE(instances.contains(this)) << schedule_note();
     }
 
     data = transcode(transcode(c.data, &c), this);
+    ++copy_assignments;
     return *this;
 }
 
 counted::operator int() const
 {
     fault_injection_disable fd;
-    EXPECT_TRUE(instances.find(this) != instances.end());
+    EXPECT_TRUE(instances.contains(this)) << schedule_note();
 
     return transcode(data, this);
 }
 
-std::set<counted const*> counted::instances;
+thread_local counted::instance_set counted::instances;
+thread_local size_t counted::copy_constructions = 0;
+thread_local size_t counted::copy_assignments = 0;
+thread_local size_t counted::destructions = 0;
 
 counted::no_new_instances_guard::no_new_instances_guard()
-    : old_instances(instances)
+    : old_count(instances.size())
+    , old_checksum(instances.hash())
 {}
 
 counted::no_new_instances_guard::~no_new_instances_guard()
 {
     fault_injection_disable fd;
-    EXPECT_TRUE(old_instances == instances);
+    EXPECT_EQ(old_count, instances.size()) << schedule_note();
+    EXPECT_EQ(old_checksum, instances.hash()) << schedule_note();
 }
 
 void counted::no_new_instances_guard::expect_no_instances()
 {
     fault_injection_disable fd;
-    EXPECT_TRUE(old_instances == instances);
+    EXPECT_EQ(old_count, instances.size()) << schedule_note();
+    EXPECT_EQ(old_checksum, instances.hash()) << schedule_note();
 }
@@ -1,10 +1,18 @@
 #pragma once
 
-#include <set>
+#include <cstddef>
+
+#include "fault_injection.h"
 
 struct counted
 {
     struct no_new_instances_guard;
+    struct instance_set;
+
+    // fault sites of the injection points in construction, copy and assignment
+    static constexpr fault_site construction_site = 1;
+    static constexpr fault_site copy_site = 2;
+    static constexpr fault_site assignment_site = 3;
 
     counted() = delete;
     counted(int data);
@@ -14,10 +22,16 @@ struct counted
     counted& operator=(counted const& c);
     operator int() const;
 
+    // Per-thread, like the instance registry: an instance must be created
+    // and destroyed on the same thread.
+    static thread_local size_t copy_constructions;
+    static thread_local size_t copy_assignments;
+    static thread_local size_t destructions;
+
 private:
     int data;
 
-    static std::set<counted const*> instances;
+    static thread_local instance_set instances;
 };
 
 struct counted::no_new_instances_guard
@@ -32,5 +46,6 @@ struct counted::no_new_instances_guard
     void expect_no_instances();
 
 private:
-    std::set<counted const*> old_instances;
+    size_t old_count;
+    size_t old_checksum;
 };
@@ -0,0 +1,274 @@
+#ifndef VECTOR_DEFERRED_DESTRUCTION_H
+#define VECTOR_DEFERRED_DESTRUCTION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "vector.h"
+
+// Destruction of large vectors on a background thread, for vectors
+// instantiated with deferred_vector_policy:
+//
+//     vector<std::string, deferred_vector_policy<>> v;
+//
+// When the last reference to a heap block holding at least the threshold of
+// bytes of elements, 1 MiB by default, is dropped, the block goes into a
+// bounded lock-free queue instead of being destroyed in place, and a single
+// reclaimer thread destroys its elements and deallocates it through Base.
+// The dropping thread pays for one compare-and-swap, and for a lock and a
+// notification only when the reclaimer sleeps. Smaller blocks are released
+// inline, as are large ones when the queue is full or the thread cannot be
+// started; vectors are never leaked.
+//
+// The reclaimer starts with the first deferred block and is stopped, after
+// emptying the queue, when static objects are destroyed at exit; blocks
+// dropped after that are released inline. Element destructors therefore run
+// on another thread and must not depend on the thread that created them.
+// deferred_destruction::drain() waits for the blocks deferred so far, which
+// makes tests and benchmarks deterministic.
+struct deferred_destruction_stats {
+    // blocks handed to the reclaimer, and those it has released
+    size_t deferred = 0;
+    size_t reclaimed = 0;
+    // blocks released inline, below the threshold or with the queue full
+    size_t below_threshold = 0;
+    size_t overflowed = 0;
+
+    // a block may be counted as reclaimed just before it is as deferred
+    size_t pending() const noexcept {
+        return deferred > reclaimed ? deferred - reclaimed : 0;
+    }
+};
+
+namespace deferred_detail {
+    typedef void (*release_function)(void *) noexcept;
+
+    constexpr size_t queue_size = 1024;
+
+    inline std::atomic<size_t> threshold{1 << 20};
+    // set once the reclaimer is gone; trivially destructible, so that it can
+    // be read by vectors destroyed after it
+    inline std::atomic<bool> stopped{false};
+
+    inline std::atomic<size_t> deferred{0};
+    inline std::atomic<size_t> reclaimed{0};
+    inline std::atomic<size_t> below_threshold{0};
+    inline std::atomic<size_t> overflowed{0};
+
+    // Bounded queue of many producers and one consumer. A cell is free for
+    // the producer that claims position i when its sequence is i, and holds
+    // an entry for the consumer when it is i + 1.
+    struct queue {
+        struct cell {
+            std::atomic<size_t> sequence;
+            void *block;
+            release_function release;
+        };
+
+        cell cells[queue_size];
+        alignas(64) std::atomic<size_t> tail{0};
+        // read and written by the consumer only
+        alignas(64) size_t head = 0;
+
+        queue() noexcept {
+            for (size_t i = 0; i != queue_size; ++i) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // False if the queue is full.
+        bool push(void *block, release_function release) noexcept {
+            size_t pos = tail.load(std::memory_order_relaxed);
+            cell *c;
+            for (;;) {
+                c = &cells[pos % queue_size];
+                size_t sequence = c->sequence.load(std::memory_order_acquire);
+                if (sequence == pos) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (sequence < pos) {
+                    // still holds the entry pushed queue_size positions ago
+                    return false;
+                } else {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+            c->block = block;
+            c->release = release;
+            c->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool ready() const noexcept {
+            return cells[head % queue_size].sequence.load(std::memory_order_acquire) == head + 1;
+        }
+
+        bool pop(void *&block, release_function &release) noexcept {
+            cell &c = cells[head % queue_size];
+            if (c.sequence.load(std::memory_order_acquire) != head + 1) {
+                return false;
+            }
+            block = c.block;
+            release = c.release;
+            c.sequence.store(head + queue_size, std::memory_order_release);
+            head++;
+            return true;
+        }
+    };
+
+    struct reclaimer {
+        queue q;
+        std::mutex mutex;
+        // the reclaimer waits for work on `wake`, drain() for it on `done`
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::atomic<bool> sleeping{false};
+        std::atomic<bool> started{false};
+        // guarded by the mutex
+        bool stopping = false;
+        std::thread thread;
+
+        static reclaimer &instance() noexcept {
+            static reclaimer r;
+            return r;
+        }
+
+        ~reclaimer() {
+            stopped.store(true, std::memory_order_seq_cst);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+
+        // False if the reclaimer cannot take the block.
+        bool defer(void *block, release_function release) noexcept {
+            if (!started.load(std::memory_order_acquire) && !start()) {
+                return false;
+            }
+            if (!q.push(block, release)) {
+                return false;
+            }
+            deferred.fetch_add(1, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping.load(std::memory_order_relaxed)) {
+                // the reclaimer is waiting, or about to see the block
+                std::lock_guard<std::mutex> lock(mutex);
+                wake.notify_one();
+            }
+            return true;
+        }
+
+        bool start() noexcept {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return false;
+            }
+            if (!thread.joinable()) {
+                try {
+                    thread = std::thread([this] { run(); });
+                } catch (...) {
+                    return false;
+                }
+            }
+            started.store(true, std::memory_order_release);
+            return true;
+        }
+
+        void run() noexcept {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                lock.unlock();
+                void *block;
+                release_function release;
+                while (q.pop(block, release)) {
+                    release(block);
+                    reclaimed.fetch_add(1, std::memory_order_release);
+                }
+                lock.lock();
+                done.notify_all();
+                if (stopping) {
+                    if (q.ready()) {
+                        continue;
+                    }
+                    return;
+                }
+                sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!q.ready()) {
+                    wake.wait(lock);
+                }
+                sleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        void drain() {
+            size_t target = deferred.load(std::memory_order_acquire);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!thread.joinable()) {
+                return;
+            }
+            wake.notify_one();
+            done.wait(lock, [target] {
+                return reclaimed.load(std::memory_order_acquire) >= target;
+            });
+        }
+    };
+}
+
+struct deferred_destruction {
+    static constexpr size_t queue_size = deferred_detail::queue_size;
+
+    // Blocks with fewer bytes of elements than this are released inline.
+    static void set_threshold(size_t bytes) noexcept {
+        deferred_detail::threshold.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t threshold() noexcept {
+        return deferred_detail::threshold.load(std::memory_order_relaxed);
+    }
+
+    // Counters of all threads since the start of the process.
+    static deferred_destruction_stats stats() noexcept {
+        deferred_destruction_stats s;
+        s.reclaimed = deferred_detail::reclaimed.load(std::memory_order_acquire);
+        s.deferred = deferred_detail::deferred.load(std::memory_order_acquire);
+        s.below_threshold = deferred_detail::below_threshold.load(std::memory_order_relaxed);
+        s.overflowed = deferred_detail::overflowed.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // Returns once every block deferred before the call has been released.
+    static void drain() {
+        if (!deferred_detail::stopped.load(std::memory_order_acquire)) {
+            deferred_detail::reclaimer::instance().drain();
+        }
+    }
+};
+
+template<typename Base = default_vector_policy>
+struct deferred_vector_policy : Base {
+    static void release_block(void *block, size_t size, void (*release)(void *) noexcept) noexcept {
+        if (size < deferred_detail::threshold.load(std::memory_order_relaxed)) {
+            deferred_detail::below_threshold.fetch_add(1, std::memory_order_relaxed);
+            Base::release_block(block, size, release);
+            return;
+        }
+        if (deferred_detail::stopped.load(std::memory_order_acquire) ||
+            !deferred_detail::reclaimer::instance().defer(block, release)) {
+            deferred_detail::overflowed.fetch_add(1, std::memory_order_relaxed);
+            Base::release_block(block, size, release);
+        }
+    }
+};
+
+#endif //VECTOR_DEFERRED_DESTRUCTION_H
@@ -0,0 +1,271 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "block_pool.h"
+#include "deferred_destruction.h"
+#include "gtest/gtest.h"
+#include "recycling_cache.h"
+#include "vector_stats.h"
+
+namespace
+{
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> destroyed_elsewhere{0};
+
+    // Counts instances across threads, and destructions on a thread other
+    // than the one that created the instance.
+    struct tracked
+    {
+        tracked(int data)
+            : data(data)
+        {
+            live++;
+        }
+
+        tracked(tracked const& other)
+            : data(other.data)
+        {
+            live++;
+        }
+
+        tracked& operator=(tracked const& other) = default;
+
+        ~tracked()
+        {
+            if (owner != std::this_thread::get_id())
+                destroyed_elsewhere++;
+            live--;
+        }
+
+        int data;
+        std::thread::id owner = std::this_thread::get_id();
+    };
+
+    typedef vector<tracked, deferred_vector_policy<>> deferred_vector;
+
+    deferred_vector make(size_t n)
+    {
+        deferred_vector v;
+        v.reserve(n);
+        for (size_t i = 0; i != n; ++i)
+            v.push_back(static_cast<int>(i));
+        return v;
+    }
+
+    // Sets the threshold for one test, and leaves nothing pending.
+    struct threshold_scope
+    {
+        explicit threshold_scope(size_t bytes)
+        {
+            deferred_destruction::set_threshold(bytes);
+        }
+
+        ~threshold_scope()
+        {
+            deferred_destruction::drain();
+            deferred_destruction::set_threshold(old);
+        }
+
+    private:
+        size_t old = deferred_destruction::threshold();
+    };
+
+    // Counts the frees of blocks of at least `large` bytes.
+    struct counting_policy : default_vector_policy
+    {
+        static inline std::atomic<size_t> large_frees{0};
+        static constexpr size_t large = 1000 * sizeof(int);
+
+        static void deallocate_block(void* block, size_t size) noexcept
+        {
+            if (size >= large)
+                large_frees++;
+            default_vector_policy::deallocate_block(block, size);
+        }
+    };
+
+    typedef recycling_vector_policy<counting_policy> recycling_inside;
+    typedef recycling_vector_policy<deferred_vector_policy<counting_policy>> recycling_outside;
+
+    // Builds vectors through both caches when destroyed on another thread,
+    // which arms the reclaimer's caches.
+    struct arms_caches
+    {
+        ~arms_caches()
+        {
+            if (owner == std::this_thread::get_id())
+                return;
+            vector<int, recycling_inside> a;
+            vector<int, recycling_outside> b;
+            for (int i = 0; i != 10; ++i)
+            {
+                a.push_back(i);
+                b.push_back(i);
+            }
+        }
+
+        std::thread::id owner = std::this_thread::get_id();
+    };
+
+    template<typename Policy>
+    void expect_released_through_base()
+    {
+        for (int round = 0; round != 3; ++round)
+        {
+            size_t frees = counting_policy::large_frees;
+            {
+                vector<arms_caches, Policy> small;
+                small.push_back(arms_caches());
+                small.push_back(arms_caches());
+                vector<int, Policy> v;
+                v.reserve(2 * counting_policy::large / sizeof(int));
+                for (size_t i = 0; i != counting_policy::large / sizeof(int); ++i)
+                    v.push_back(1);
+            }
+            deferred_destruction::drain();
+            EXPECT_EQ(frees + 1, counting_policy::large_frees);
+        }
+    }
+
+    deferred_destruction_stats operator-(deferred_destruction_stats a, deferred_destruction_stats const& b)
+    {
+        a.deferred -= b.deferred;
+        a.reclaimed -= b.reclaimed;
+        a.below_threshold -= b.below_threshold;
+        a.overflowed -= b.overflowed;
+        return a;
+    }
+}
+
+TEST(deferred_destruction, large_blocks_are_destroyed_by_the_reclaimer)
+{
+    threshold_scope t(100 * sizeof(tracked));
+    deferred_destruction_stats before = deferred_destruction::stats();
+    size_t elsewhere = destroyed_elsewhere;
+    {
+        deferred_vector v = make(1000);
+        EXPECT_EQ(1000u, live);
+    }
+    deferred_destruction::drain();
+    EXPECT_EQ(0u, live);
+    EXPECT_EQ(1000u, destroyed_elsewhere - elsewhere);
+    deferred_destruction_stats d = deferred_destruction::stats() - before;
+    EXPECT_EQ(1u, d.deferred);
+    EXPECT_EQ(1u, d.reclaimed);
+    EXPECT_EQ(0u, deferred_destruction::stats().pending());
+}
+
+TEST(deferred_destruction, small_blocks_are_destroyed_inline)
+{
+    threshold_scope t(100 * sizeof(tracked));
+    deferred_destruction_stats before = deferred_destruction::stats();
+    size_t elsewhere = destroyed_elsewhere;
+    {
+        deferred_vector v = make(99);
+        deferred_vector w = make(1);
+    }
+    EXPECT_EQ(0u, live);
+    EXPECT_EQ(elsewhere, destroyed_elsewhere);
+    deferred_destruction_stats d = deferred_destruction::stats() - before;
+    EXPECT_EQ(0u, d.deferred);
+    EXPECT_EQ(2u, d.below_threshold);
+}
+
+TEST(deferred_destruction, threshold_counts_elements_not_capacity)
+{
+    threshold_scope t(100 * sizeof(tracked));
+    deferred_destruction_stats before = deferred_destruction::stats();
+    {
+        deferred_vector v;
+        v.reserve(1000);
+        v.push_back(1);
+    }
+    EXPECT_EQ(0u, live);
+    EXPECT_EQ(0u, (deferred_destruction::stats() - before).deferred);
+}
+
+TEST(deferred_destruction, shared_block_is_deferred_with_its_last_reference)
+{
+    threshold_scope t(100 * sizeof(tracked));
+    deferred_destruction_stats before = deferred_destruction::stats();
+    deferred_vector v = make(1000);
+    {
+        deferred_vector copy = v;
+        EXPECT_EQ(1000u, live);
+    }
+    EXPECT_EQ(0u, (deferred_destruction::stats() - before).deferred);
+    EXPECT_EQ(1000u, live);
+    v = deferred_vector();
+    deferred_destruction::drain();
+    EXPECT_EQ(0u, live);
+    EXPECT_EQ(1u, (deferred_destruction::stats() - before).deferred);
+}
+
+TEST(deferred_destruction, full_queue_falls_back_to_inline)
+{
+    threshold_scope t(0);
+    deferred_destruction_stats before = deferred_destruction::stats();
+    {
+        std::vector<deferred_vector> vs;
+        for (size_t i = 0; i != 4 * deferred_destruction::queue_size; ++i)
+            vs.push_back(make(2));
+    }
+    deferred_destruction::drain();
+    EXPECT_EQ(0u, live);
+    deferred_destruction_stats d = deferred_destruction::stats() - before;
+    EXPECT_EQ(4 * deferred_destruction::queue_size, d.deferred + d.overflowed);
+    EXPECT_EQ(d.deferred, d.reclaimed);
+}
+
+TEST(deferred_destruction, threads)
+{
+    threshold_scope t(0);
+    deferred_destruction_stats before = deferred_destruction::stats();
+    std::vector<std::thread> threads;
+    for (int i = 0; i != 4; ++i)
+        threads.emplace_back([] {
+            for (int round = 0; round != 1000; ++round)
+            {
+                deferred_vector v = make(10);
+                deferred_vector copy = v;
+                copy[0] = 1;
+            }
+        });
+    for (auto& thread : threads)
+        thread.join();
+    deferred_destruction::drain();
+    EXPECT_EQ(0u, live);
+    deferred_destruction_stats d = deferred_destruction::stats() - before;
+    EXPECT_EQ(8000u, d.deferred + d.overflowed);
+    EXPECT_EQ(d.deferred, d.reclaimed);
+}
+
+TEST(deferred_destruction, composes_with_other_policies)
+{
+    threshold_scope t(0);
+    vector_stats before = vector_stats::snapshot();
+    deferred_destruction_stats deferred = deferred_destruction::stats();
+    {
+        vector<int, deferred_vector_policy<vector_stats_policy>> v;
+        for (int i = 0; i != 100; ++i)
+            v.push_back(i);
+        vector<int, deferred_vector_policy<pooled_vector_policy>> w;
+        for (int i = 0; i != 10; ++i)
+            w.push_back(i);
+    }
+    deferred_destruction::drain();
+    // reallocations to 4, ..., 128, and the last block, released elsewhere
+    EXPECT_EQ(7u, (vector_stats::snapshot() - before).frees);
+    deferred_destruction_stats d = deferred_destruction::stats() - deferred;
+    // growth drops blocks too: 7 of v and 4 of w, with capacities up to 16
+    EXPECT_EQ(11u, d.deferred + d.overflowed);
+}
+
+TEST(deferred_destruction, reclaimer_bypasses_recycling_cache)
+{
+    threshold_scope t(0);
+    // the reclaimer parks nothing, in whichever order the policies nest
+    expect_released_through_base<deferred_vector_policy<recycling_inside>>();
+    expect_released_through_base<recycling_outside>();
+}
@@ -0,0 +1,90 @@
+#ifndef VECTOR_EPOCH_DOMAIN_H
+#define VECTOR_EPOCH_DOMAIN_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+// Minimal read-copy-update grace periods.
+//
+// A thread enters a short critical section by holding a guard. The guard
+// counts the thread in its own slot, keyed by the parity of the current
+// epoch. synchronize() advances the epoch and waits until every slot's
+// count for the previous parity has dropped to zero. When it returns, every
+// critical section that started before the call has finished.
+//
+// Critical sections should only run a handful of instructions: synchronize()
+// spins on them.
+class epoch_domain {
+public:
+    static constexpr size_t slot_count = 64;
+
+    class guard {
+    public:
+        explicit guard(epoch_domain &d) noexcept: domain(d), slot_index(this_thread_slot()) {
+            auto &slot = domain.slots[slot_index];
+            for (;;) {
+                size_t e = domain.epoch.load();
+                parity = e & 1;
+                slot.active[parity].fetch_add(1);
+                if (domain.epoch.load() == e) {
+                    return;
+                }
+                slot.active[parity].fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        guard(guard const &) = delete;
+
+        guard &operator=(guard const &) = delete;
+
+        ~guard() {
+            domain.slots[slot_index].active[parity].fetch_sub(1, std::memory_order_release);
+        }
+
+        // Slot of the current thread, also usable to pick a counter shard.
+        size_t slot() const noexcept {
+            return slot_index;
+        }
+
+    private:
+        epoch_domain &domain;
+        size_t slot_index;
+        size_t parity;
+    };
+
+    // Shared by every versioned_vector: snapshots may outlive their owner.
+    static epoch_domain &global() noexcept {
+        static epoch_domain domain;
+        return domain;
+    }
+
+    void synchronize() {
+        std::lock_guard<std::mutex> lock(writers);
+        size_t e = epoch.load(std::memory_order_relaxed);
+        epoch.store(e + 1);
+        for (auto &slot : slots) {
+            while (slot.active[e & 1].load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct alignas(64) reader_slot {
+        std::atomic<size_t> active[2] = {};
+    };
+
+    std::atomic<size_t> epoch{0};
+    std::mutex writers;
+    reader_slot slots[slot_count];
+
+    static size_t this_thread_slot() noexcept {
+        static std::atomic<size_t> next_slot{0};
+        thread_local size_t index = next_slot.fetch_add(1, std::memory_order_relaxed) % slot_count;
+        return index;
+    }
+};
+
+#endif //VECTOR_EPOCH_DOMAIN_H
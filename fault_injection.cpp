@@ -1,63 +1,82 @@
 #include "fault_injection.h"
+#include "alloc_stats.h"
+#include "mmap_allocator.h"
+#include "no_alloc.h"
+#include "work_stealing_pool.h"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
+#include <new>
 #include <vector>
 
-#include <sys/mman.h>
-
 namespace
 {
-    template <typename T>
-    struct mmap_allocator
-    {
-        using value_type = T;
-
-        mmap_allocator() = default;
-        
-        T* allocate(size_t n)
-        {
-            void* ptr = mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-            if (ptr == MAP_FAILED)
-                throw std::bad_alloc();
-            return reinterpret_cast<T*>(ptr);
-        }
-        
-        void deallocate(void* p, std::size_t n)
-        {
-            int r = munmap(p, n);
-            if (r != 0)
-                std::abort();
-        }
-        
-    };
+    thread_local bool disabled = false;
+}
 
+#ifndef NO_FAULT_INJECTION
+namespace
+{
     struct fault_injection_context
     {
         std::vector<size_t, mmap_allocator<size_t> > skip_ranges;
         size_t error_index = 0;
         size_t skip_index = 0;
         bool fault_registred = false;
+        // replay injects the faults in skip_ranges and nothing after them
+        bool replay = false;
+        fault_filter const* filter = nullptr;
     };
 
-    thread_local bool disabled = false;
     thread_local fault_injection_context* context = nullptr;
 
-    void dump_state()
+    bool eligible_site(fault_site site)
+    {
+        fault_filter const* filter = context->filter;
+        if (!filter)
+            return true;
+        if (!filter->points)
+            return false;
+        return filter->sites.empty()
+            || std::find(filter->sites.begin(), filter->sites.end(), site) != filter->sites.end();
+    }
+
+    bool eligible_allocation(size_t size)
     {
-#if 0
-        std::cout << "skip_ranges: {";
-        if (!context->skip_ranges.empty())
+        fault_filter const* filter = context->filter;
+        return !filter || (filter->allocations && size >= filter->min_allocation_size);
+    }
+
+    bool next_point_faults()
+    {
+        assert(context->error_index <= context->skip_ranges.size());
+        if (context->error_index == context->skip_ranges.size())
         {
-            std::cout << context->skip_ranges[0];
-            for (size_t i = 1; i != context->skip_ranges.size(); ++i)
-                std::cout << ", " << context->skip_ranges[i];
+            if (context->replay)
+                return false;
+            ++context->error_index;
+            context->skip_ranges.push_back(0);
+            context->fault_registred = true;
+            return true;
         }
-        std::cout << "}\nerror_index: " << context->error_index << "\nskip_index: " << context->skip_index << '\n' << std::flush;
-#endif
+
+        assert(context->skip_index <= context->skip_ranges[context->error_index]);
+
+        if (context->skip_index == context->skip_ranges[context->error_index])
+        {
+            ++context->error_index;
+            context->skip_index = 0;
+            context->fault_registred = true;
+            return true;
+        }
+
+        ++context->skip_index;
+        return false;
     }
 }
 
-bool should_inject_fault()
+bool should_inject_fault(fault_site site)
 {
     if (!context)
         return false;
@@ -65,68 +84,199 @@ bool should_inject_fault()
     if (disabled)
         return false;
 
-    assert(context->error_index <= context->skip_ranges.size());
-    if (context->error_index == context->skip_ranges.size())
-    {
-        ++context->error_index;
-        context->skip_ranges.push_back(0);
-        context->fault_registred = true;
-        return true;
-    }
+    return eligible_site(site) && next_point_faults();
+}
 
-    assert(context->skip_index <= context->skip_ranges[context->error_index]);
+bool should_inject_allocation_fault(size_t size)
+{
+    if (!context)
+        return false;
 
-    if (context->skip_index == context->skip_ranges[context->error_index])
-    {
-        ++context->error_index;
-        context->skip_index = 0;
-        context->fault_registred = true;
-        return true;
-    }
+    if (disabled)
+        return false;
 
-    ++context->skip_index;
-    return false;
+    return eligible_allocation(size) && next_point_faults();
 }
 
-void fault_injection_point()
+void fault_injection_point(fault_site site)
 {
-    if (should_inject_fault())
+    if (should_inject_fault(site))
         throw injected_fault("injected fault");
 }
 
-void faulty_run(std::function<void ()> const& f)
+std::string current_fault_schedule()
 {
-#if 0
-    f();
-#else
-    assert(!context);
-    fault_injection_context ctx;
-    context = &ctx;
-    for (;;)
+    if (!context)
+        return std::string();
+
+    fault_injection_disable dg;
+    std::string result;
+    for (size_t i = 0; i != context->error_index; ++i)
+    {
+        if (i != 0)
+            result += ',';
+        result += std::to_string(context->skip_ranges[i]);
+    }
+    return result;
+}
+
+namespace
+{
+    void serial_faulty_run(std::function<void ()> const& f, fault_filter const& filter)
     {
+        assert(!context);
+        fault_injection_context ctx;
+        ctx.filter = &filter;
+        context = &ctx;
+        for (;;)
+        {
+            try
+            {
+                f();
+            }
+            catch (...)
+            {
+                fault_injection_disable dg;
+                ctx.skip_ranges.resize(ctx.error_index);
+                ++ctx.skip_ranges.back();
+                ctx.error_index = 0;
+                ctx.skip_index = 0;
+                assert(ctx.fault_registred);
+                ctx.fault_registred = false;
+                continue;
+            }
+            assert(!ctx.fault_registred);
+            break;
+        }
+        context = nullptr;
+    }
+
+    // Runs f once under the schedule in ctx.skip_ranges.
+    // Returns true if f completed without an exception.
+    bool run_schedule(std::function<void ()> const& f, fault_injection_context& ctx)
+    {
+        assert(!context);
+        ctx.error_index = 0;
+        ctx.skip_index = 0;
+        ctx.fault_registred = false;
+        context = &ctx;
         try
         {
             f();
         }
         catch (...)
         {
-            fault_injection_disable dg;
-            dump_state();
+            context = nullptr;
+            assert(ctx.fault_registred);
+            return false;
+        }
+        context = nullptr;
+        return true;
+    }
+
+    // Explores every schedule that starts with `prefix`, in the same order as
+    // serial_faulty_run does. After the first run proves that the last fault
+    // of `prefix` is reachable, the sibling prefix (last skip count + 1) is
+    // handed to the pool, so the top-level skip counts spread over workers.
+    void explore(work_stealing_pool& pool, std::function<void ()> const& f, fault_filter const& filter,
+                 std::vector<size_t, mmap_allocator<size_t> > prefix)
+    {
+        size_t depth = prefix.size();
+        fault_injection_context ctx;
+        ctx.skip_ranges = std::move(prefix);
+        ctx.filter = &filter;
+        for (bool first = true;; first = false)
+        {
+            if (run_schedule(f, ctx))
+            {
+                assert(!ctx.fault_registred);
+                return;
+            }
+            if (first)
+            {
+                // the last fault of the prefix was never reached: neither this
+                // prefix nor any of its later siblings inject anything new
+                if (ctx.error_index < depth)
+                    return;
+
+                std::vector<size_t, mmap_allocator<size_t> > sibling(ctx.skip_ranges.begin(),
+                                                                     ctx.skip_ranges.begin() + depth);
+                ++sibling.back();
+                pool.submit([&pool, &f, &filter, sibling] { explore(pool, f, filter, sibling); });
+            }
             ctx.skip_ranges.resize(ctx.error_index);
+            if (ctx.skip_ranges.size() <= depth)
+                return;
             ++ctx.skip_ranges.back();
-            ctx.error_index = 0;
-            ctx.skip_index = 0;
-            assert(ctx.fault_registred);
-            ctx.fault_registred = false;
-            continue;
         }
-        assert(!ctx.fault_registred);
-        break;
     }
-    context = nullptr;
-#endif
+
+    size_t default_threads()
+    {
+        if (char const* env = std::getenv("FAULTY_RUN_THREADS"))
+            return std::strtoul(env, nullptr, 10);
+        return std::thread::hardware_concurrency();
+    }
+}
+
+void faulty_run(std::function<void ()> const& f, fault_filter const& filter)
+{
+    parallel_faulty_run(f, default_threads(), filter);
+}
+
+void parallel_faulty_run(std::function<void ()> const& f, size_t threads, fault_filter const& filter)
+{
+    if (threads <= 1)
+    {
+        serial_faulty_run(f, filter);
+        return;
+    }
+
+    work_stealing_pool pool(threads - 1);
+    std::vector<size_t, mmap_allocator<size_t> > first(1, 0);
+    pool.submit([&pool, &f, &filter, first] { explore(pool, f, filter, first); });
+    pool.wait();
+}
+
+void faulty_run_replay(std::function<void ()> const& f, std::string const& schedule, fault_filter const& filter)
+{
+    fault_injection_context ctx;
+    ctx.replay = true;
+    ctx.filter = &filter;
+    for (size_t pos = 0; pos < schedule.size();)
+    {
+        size_t comma = std::min(schedule.find(',', pos), schedule.size());
+        ctx.skip_ranges.push_back(std::stoul(schedule.substr(pos, comma - pos)));
+        pos = comma + 1;
+    }
+
+    if (run_schedule(f, ctx))
+        return;
+    if (ctx.error_index != ctx.skip_ranges.size())
+        throw std::logic_error("fault schedule \"" + schedule + "\" did not replay");
+}
+#else
+void faulty_run(std::function<void ()> const& f, fault_filter const&)
+{
+    f();
+}
+
+void parallel_faulty_run(std::function<void ()> const& f, size_t, fault_filter const&)
+{
+    f();
 }
 
+void faulty_run_replay(std::function<void ()> const& f, std::string const&, fault_filter const&)
+{
+    f();
+}
+
+std::string current_fault_schedule()
+{
+    return std::string();
+}
+#endif
+
 fault_injection_disable::fault_injection_disable()
     : was_disabled(disabled)
 {
@@ -140,44 +290,185 @@ fault_injection_disable::~fault_injection_disable()
 
 void* operator new(std::size_t count)
 {
-    if (should_inject_fault())
+    no_alloc_scope::check(count);
+
+    if (should_inject_allocation_fault(count))
         throw std::bad_alloc();
 
     void* ptr = malloc(count);
     if (!ptr)
         throw std::bad_alloc();
 
+    alloc_stats::record_allocation(ptr, count);
     return ptr;
 }
 
 void* operator new[](std::size_t count)
 {
-    if (should_inject_fault())
+    no_alloc_scope::check(count);
+
+    if (should_inject_allocation_fault(count))
         throw std::bad_alloc();
 
     void* ptr = malloc(count);
     if (!ptr)
         throw std::bad_alloc();
 
+    alloc_stats::record_allocation(ptr, count);
     return ptr;
 }
 
+namespace
+{
+    // The aligned overloads, which block_pool uses for its slabs, go through
+    // the same checks as the plain ones.
+    void* allocate_aligned(std::size_t count, std::align_val_t al)
+    {
+        no_alloc_scope::check(count);
+
+        if (should_inject_allocation_fault(count))
+            throw std::bad_alloc();
+
+        auto alignment = static_cast<std::size_t>(al);
+        // aligned_alloc wants a non-zero multiple of the alignment
+        std::size_t rounded = (std::max<std::size_t>(count, 1) + alignment - 1) / alignment * alignment;
+        void* ptr = std::aligned_alloc(alignment, rounded);
+        if (!ptr)
+            throw std::bad_alloc();
+
+        alloc_stats::record_allocation(ptr, count);
+        return ptr;
+    }
+}
+
+void* operator new(std::size_t count, std::align_val_t al)
+{
+    return allocate_aligned(count, al);
+}
+
+void* operator new[](std::size_t count, std::align_val_t al)
+{
+    return allocate_aligned(count, al);
+}
+
+void* operator new(std::size_t count, std::align_val_t al, std::nothrow_t const&) noexcept
+{
+    try
+    {
+        return allocate_aligned(count, al);
+    }
+    catch (std::bad_alloc const&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t count, std::align_val_t al, std::nothrow_t const&) noexcept
+{
+    try
+    {
+        return allocate_aligned(count, al);
+    }
+    catch (std::bad_alloc const&)
+    {
+        return nullptr;
+    }
+}
+
+// Also replaced so that they pair with the replaced operator delete when a
+// sanitizer runtime provides its own nothrow versions.
+void* operator new(std::size_t count, std::nothrow_t const&) noexcept
+{
+    try
+    {
+        return operator new(count);
+    }
+    catch (std::bad_alloc const&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t count, std::nothrow_t const&) noexcept
+{
+    try
+    {
+        return operator new[](count);
+    }
+    catch (std::bad_alloc const&)
+    {
+        return nullptr;
+    }
+}
+
 void operator delete(void* ptr) noexcept
 {
+    alloc_stats::record_deallocation(ptr);
     free(ptr);
 }
 
 void operator delete[](void* ptr) noexcept
 {
+    alloc_stats::record_deallocation(ptr);
     free(ptr);
 }
 
 void operator delete(void* ptr, std::size_t) noexcept
 {
+    alloc_stats::record_deallocation(ptr);
     free(ptr);
 }
 
 void operator delete[](void* ptr, std::size_t) noexcept
 {
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::nothrow_t const&) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::nothrow_t const&) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, std::nothrow_t const&) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, std::nothrow_t const&) noexcept
+{
+    alloc_stats::record_deallocation(ptr);
     free(ptr);
 }
@@ -2,15 +2,81 @@
 
 #include <functional>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 struct injected_fault : std::runtime_error
 {
     using runtime_error::runtime_error;
 };
 
-bool should_inject_fault();
-void fault_injection_point();
-void faulty_run(std::function<void ()> const& f);
+// Tag of a fault_injection_point; 0 marks untagged points.
+typedef unsigned fault_site;
+
+// Restricts which points count as injection points during faulty_run.
+// Points rejected by the filter are neither faulted nor counted, so a
+// narrow filter shrinks the number of explored schedules accordingly.
+struct fault_filter
+{
+    bool allocations = true;
+    size_t min_allocation_size = 0;
+    bool points = true;
+    // when non-empty, only points tagged with one of these sites qualify
+    std::vector<fault_site> sites;
+
+    static fault_filter allocations_of_at_least(size_t size)
+    {
+        fault_filter result;
+        result.min_allocation_size = size;
+        result.points = false;
+        return result;
+    }
+
+    static fault_filter only_sites(std::vector<fault_site> sites)
+    {
+        fault_filter result;
+        result.allocations = false;
+        result.sites = std::move(sites);
+        return result;
+    }
+};
+
+// Defining NO_FAULT_INJECTION turns the hooks into inline no-ops, so code
+// linked against the replacement operator new only pays for alloc_stats,
+// and faulty_run simply calls f once.
+#ifdef NO_FAULT_INJECTION
+inline bool should_inject_fault(fault_site = 0)
+{
+    return false;
+}
+
+inline bool should_inject_allocation_fault(size_t)
+{
+    return false;
+}
+
+inline void fault_injection_point(fault_site = 0)
+{}
+#else
+bool should_inject_fault(fault_site site = 0);
+bool should_inject_allocation_fault(size_t size);
+void fault_injection_point(fault_site site = 0);
+#endif
+
+void faulty_run(std::function<void ()> const& f, fault_filter const& filter = fault_filter());
+
+// Explores the same fault schedules as faulty_run on `threads` threads
+// (the caller included). f must only touch thread-local or its own state.
+// faulty_run itself uses all cores unless FAULTY_RUN_THREADS says otherwise.
+void parallel_faulty_run(std::function<void ()> const& f, size_t threads,
+                         fault_filter const& filter = fault_filter());
+
+// Faults injected so far in the run on this thread, as comma-separated skip
+// counts (e.g. "3,0,1"); empty outside of faulty_run. Passing it with the
+// same filter to faulty_run_replay re-runs f with exactly these faults.
+std::string current_fault_schedule();
+void faulty_run_replay(std::function<void ()> const& f, std::string const& schedule,
+                       fault_filter const& filter = fault_filter());
 
 struct fault_injection_disable
 {
@@ -0,0 +1,306 @@
+#ifndef VECTOR_INCREMENTAL_VECTOR_H
+#define VECTOR_INCREMENTAL_VECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "indexed_iterator.h"
+#include "vector.h"
+
+// Growable array whose push_back never copies more than a few elements.
+//
+// When vector runs out of capacity, one push_back copies the whole buffer
+// into a block twice as large. Here the new block is allocated, and the
+// elements stay in the old one: every later push_back moves
+// migrate_per_push of them across, lowest index first, until none is left
+// and the old block is freed. Migration completes well before the new block
+// fills up, so at most two blocks exist at a time. While it runs,
+// element i lives in the new block if it has already moved (i < migrated)
+// or was pushed after the growth (i >= old capacity), and in the old block
+// otherwise; operator[] pays one extra comparison for that.
+//
+// The elements are not always contiguous; for_each_chunk() visits them as
+// up to three runs, and flatten() copies them into a vector. Copies are
+// deep, as the point of the container is a bounded cost per write. Moves
+// are used for migration when they cannot throw, copies otherwise, so
+// push_back keeps the strong guarantee.
+template<typename T>
+class incremental_vector {
+public:
+    typedef T value_type;
+    typedef T &reference;
+    typedef T const &const_reference;
+
+    // Enough to finish migrating before the new, twice larger block is full.
+    static constexpr size_t migrate_per_push = 2;
+
+    typedef indexed_const_iterator<incremental_vector, T> const_iterator;
+    incremental_vector() noexcept = default;
+
+    incremental_vector(incremental_vector const &other) {
+        if (other.count == 0) {
+            return;
+        }
+        T *block = allocate(other.count);
+        size_t i = 0;
+        try {
+            for (; i != other.count; ++i) {
+                new(block + i) T(other[i]);
+            }
+        } catch (...) {
+            std::destroy(block, block + i);
+            deallocate(block);
+            throw;
+        }
+        data = block;
+        cap = count = other.count;
+    }
+
+    incremental_vector(incremental_vector &&other) noexcept {
+        swap(other);
+    }
+
+    incremental_vector &operator=(incremental_vector const &other) {
+        if (this != &other) {
+            incremental_vector copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    incremental_vector &operator=(incremental_vector &&other) noexcept {
+        incremental_vector moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    ~incremental_vector() {
+        clear();
+        deallocate(data);
+    }
+
+    void swap(incremental_vector &other) noexcept {
+        std::swap(data, other.data);
+        std::swap(cap, other.cap);
+        std::swap(old, other.old);
+        std::swap(old_cap, other.old_cap);
+        std::swap(migrated, other.migrated);
+        std::swap(count, other.count);
+    }
+
+    size_t size() const noexcept {
+        return count;
+    }
+
+    bool empty() const noexcept {
+        return count == 0;
+    }
+
+    size_t capacity() const noexcept {
+        return cap;
+    }
+
+    // Whether an old block still holds some of the elements.
+    bool migrating() const noexcept {
+        return old != nullptr;
+    }
+
+    reference operator[](size_t i) noexcept {
+        return *locate(i);
+    }
+
+    const_reference operator[](size_t i) const noexcept {
+        return *locate(i);
+    }
+
+    reference back() noexcept {
+        return *locate(count - 1);
+    }
+
+    const_reference back() const noexcept {
+        return *locate(count - 1);
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(this, count);
+    }
+
+    // At most one allocation and migrate_per_push + 1 element copies.
+    void push_back(const_reference value) {
+        if (count == cap) {
+            grow(value);
+        } else {
+            // value may be an element, so it is copied before any migrates
+            new(locate(count)) T(value);
+            count++;
+        }
+        try {
+            migrate(migrate_per_push);
+        } catch (...) {
+            pop_back();
+            throw;
+        }
+    }
+
+    void pop_back() noexcept {
+        assert(count != 0);
+        std::destroy_at(locate(count - 1));
+        count--;
+        if (old != nullptr && migrated >= std::min(count, old_cap)) {
+            finish();
+        }
+    }
+
+    void clear() noexcept {
+        for (size_t i = count; i != 0; --i) {
+            std::destroy_at(locate(i - 1));
+        }
+        count = 0;
+        if (old != nullptr) {
+            finish();
+        }
+    }
+
+    // Moves every element into one block of at least n elements, all at once.
+    void reserve(size_t n) {
+        if (n <= cap && old == nullptr) {
+            return;
+        }
+        n = std::max(n, cap);
+        T *block = allocate(n);
+        size_t i = 0;
+        try {
+            for (; i != count; ++i) {
+                new(block + i) T(std::move_if_noexcept(*locate(i)));
+            }
+        } catch (...) {
+            std::destroy(block, block + i);
+            deallocate(block);
+            throw;
+        }
+        size_t n_old = count;
+        clear();
+        deallocate(data);
+        data = block;
+        cap = n;
+        count = n_old;
+    }
+
+    // Calls f(data, size) for each contiguous run of elements in order.
+    template<typename F>
+    void for_each_chunk(F f) const {
+        if (old == nullptr) {
+            if (count != 0) {
+                f(static_cast<T const *>(data), count);
+            }
+            return;
+        }
+        size_t old_end = std::min(count, old_cap);
+        if (migrated != 0) {
+            f(static_cast<T const *>(data), migrated);
+        }
+        if (old_end != migrated) {
+            f(static_cast<T const *>(old) + migrated, old_end - migrated);
+        }
+        if (count > old_cap) {
+            f(static_cast<T const *>(data) + old_cap, count - old_cap);
+        }
+    }
+
+    // Contiguous copy of the elements, made with one allocation.
+    vector<T> flatten() const {
+        vector<T> result;
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            result.overwrite(count, [this](T *out) {
+                for_each_chunk([&out](T const *p, size_t n) {
+                    std::memcpy(static_cast<void *>(out), p, n * sizeof(T));
+                    out += n;
+                });
+            });
+        } else {
+            result.reserve(count);
+            for_each_chunk([&result](T const *p, size_t n) {
+                for (size_t i = 0; i != n; ++i) {
+                    result.push_back(p[i]);
+                }
+            });
+        }
+        return result;
+    }
+
+private:
+    static T *allocate(size_t n) {
+        return static_cast<T *>(operator new(n * sizeof(T)));
+    }
+
+    static void deallocate(T *block) noexcept {
+        operator delete(static_cast<void *>(block));
+    }
+
+    T *locate(size_t i) const noexcept {
+        return old != nullptr && i >= migrated && i < old_cap ? old + i : data + i;
+    }
+
+    // Starts migrating into a block twice as large, with value appended.
+    void grow(const_reference value) {
+        assert(old == nullptr);
+        size_t new_cap = cap == 0 ? 1 : 2 * cap;
+        T *block = allocate(new_cap);
+        try {
+            new(block + count) T(value);
+        } catch (...) {
+            deallocate(block);
+            throw;
+        }
+        old = std::exchange(data, block);
+        old_cap = std::exchange(cap, new_cap);
+        migrated = 0;
+        count++;
+    }
+
+    // Moves up to `steps` elements out of the old block, freeing it once
+    // empty. Each element is destroyed only after its copy is made.
+    void migrate(size_t steps) {
+        if (old == nullptr) {
+            return;
+        }
+        size_t old_end = std::min(count, old_cap);
+        for (; steps != 0 && migrated != old_end; --steps) {
+            new(data + migrated) T(std::move_if_noexcept(old[migrated]));
+            std::destroy_at(old + migrated);
+            migrated++;
+        }
+        if (migrated == old_end) {
+            finish();
+        }
+    }
+
+    // The old block holds no element any more.
+    void finish() noexcept {
+        deallocate(old);
+        old = nullptr;
+        old_cap = 0;
+        migrated = 0;
+    }
+
+    T *data = nullptr;
+    size_t cap = 0;
+    // the block being emptied, and how many of its elements have moved
+    T *old = nullptr;
+    size_t old_cap = 0;
+    size_t migrated = 0;
+    size_t count = 0;
+};
+
+#endif //VECTOR_INCREMENTAL_VECTOR_H
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "counted.h"
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+#include "incremental_vector.h"
+
+TEST(incremental_vector, push_back)
+{
+    incremental_vector<int> v;
+    for (int i = 0; i != 1000; ++i)
+    {
+        v.push_back(i);
+        ASSERT_EQ(static_cast<size_t>(i + 1), v.size());
+        for (int j = 0; j <= i; j += 37)
+            ASSERT_EQ(j, v[j]);
+        ASSERT_EQ(i, v.back());
+    }
+    EXPECT_EQ(1024u, v.capacity());
+    // 1000 - 512 pushes since the last growth, two moves each
+    EXPECT_FALSE(v.migrating());
+}
+
+TEST(incremental_vector, migration_is_incremental)
+{
+    incremental_vector<int> v;
+    for (int i = 0; i != 64; ++i)
+        v.push_back(i);
+    ASSERT_FALSE(v.migrating());
+
+    alloc_stats_scope s;
+    v.push_back(64);
+    EXPECT_EQ(128u, v.capacity());
+    EXPECT_TRUE(v.migrating());
+    EXPECT_EQ(1u, s.stats().allocations);
+    EXPECT_EQ(0u, s.stats().deallocations);
+
+    // 64 old elements, two per push; the growth itself moved the first two
+    for (int i = 65; i != 95; ++i)
+    {
+        v.push_back(i);
+        EXPECT_TRUE(v.migrating());
+    }
+    v.push_back(95);
+    EXPECT_FALSE(v.migrating());
+    EXPECT_EQ(1u, s.stats().allocations);
+    EXPECT_EQ(1u, s.stats().deallocations);
+    for (int i = 0; i != 96; ++i)
+        EXPECT_EQ(i, v[i]);
+}
+
+TEST(incremental_vector, push_back_own_element)
+{
+    incremental_vector<std::string> v;
+    for (int i = 0; i != 33; ++i)
+        v.push_back(std::to_string(i));
+    ASSERT_TRUE(v.migrating());
+    v.push_back(v[2]);
+    v.push_back(v[20]);
+    v.push_back(v.back());
+    EXPECT_EQ("2", v[33]);
+    EXPECT_EQ("20", v[34]);
+    EXPECT_EQ("20", v[35]);
+    for (int i = 0; i != 33; ++i)
+        EXPECT_EQ(std::to_string(i), v[i]);
+}
+
+TEST(incremental_vector, pop_back_while_migrating)
+{
+    incremental_vector<int> v;
+    for (int i = 0; i != 17; ++i)
+        v.push_back(i);
+    ASSERT_TRUE(v.migrating());
+    for (int i = 0; i != 10; ++i)
+        v.pop_back();
+    EXPECT_EQ(7u, v.size());
+    EXPECT_TRUE(v.migrating());
+    // the new elements land in the old block and migrate with the rest
+    for (int i = -1; i != -5; --i)
+        v.push_back(i);
+    EXPECT_TRUE(v.migrating());
+    v.push_back(-5);
+    EXPECT_FALSE(v.migrating());
+    std::vector<int> expected = {0, 1, 2, 3, 4, 5, 6, -1, -2, -3, -4, -5};
+    EXPECT_EQ(expected, std::vector<int>(v.begin(), v.end()));
+
+    while (!v.empty())
+        v.pop_back();
+    EXPECT_EQ(32u, v.capacity());
+}
+
+TEST(incremental_vector, chunks_and_flatten)
+{
+    incremental_vector<int> v;
+    for (int i = 0; i != 40; ++i)
+        v.push_back(i);
+    ASSERT_TRUE(v.migrating());
+
+    std::vector<int> seen;
+    size_t chunks = 0;
+    v.for_each_chunk([&](int const *p, size_t n)
+                     {
+                         seen.insert(seen.end(), p, p + n);
+                         chunks++;
+                     });
+    EXPECT_EQ(3u, chunks);
+    EXPECT_EQ(std::vector<int>(v.begin(), v.end()), seen);
+
+    alloc_stats_scope s;
+    vector<int> flat = v.flatten();
+    EXPECT_EQ(1u, s.stats().allocations);
+    ASSERT_EQ(40u, flat.size());
+    for (int i = 0; i != 40; ++i)
+        EXPECT_EQ(i, flat[i]);
+
+    incremental_vector<std::string> words;
+    for (int i = 0; i != 40; ++i)
+        words.push_back(std::to_string(i));
+    ASSERT_TRUE(words.migrating());
+    vector<std::string> flat_words = words.flatten();
+    ASSERT_EQ(40u, flat_words.size());
+    EXPECT_TRUE(std::equal(words.begin(), words.end(), flat_words.begin()));
+}
+
+TEST(incremental_vector, copy_move_reserve)
+{
+    incremental_vector<std::string> v;
+    for (int i = 0; i != 20; ++i)
+        v.push_back(std::to_string(i));
+    ASSERT_TRUE(v.migrating());
+
+    incremental_vector<std::string> copy = v;
+    EXPECT_FALSE(copy.migrating());
+    EXPECT_EQ(20u, copy.capacity());
+
+    incremental_vector<std::string> moved = std::move(v);
+    EXPECT_TRUE(v.empty());
+    EXPECT_TRUE(moved.migrating());
+
+    moved.reserve(100);
+    EXPECT_FALSE(moved.migrating());
+    EXPECT_EQ(100u, moved.capacity());
+    for (int i = 0; i != 20; ++i)
+    {
+        EXPECT_EQ(std::to_string(i), copy[i]);
+        EXPECT_EQ(std::to_string(i), moved[i]);
+    }
+
+    moved.clear();
+    v = copy;
+    EXPECT_EQ(20u, v.size());
+    EXPECT_EQ("19", v.back());
+}
+
+TEST(incremental_vector, strong_guarantee)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   incremental_vector<counted> v;
+                   for (int i = 0; i != 9; ++i)
+                       v.push_back(i);
+                   try
+                   {
+                       for (int i = 9; i != 40; ++i)
+                           v.push_back(i);
+                   }
+                   catch (...)
+                   {
+                       for (size_t i = 0; i != v.size(); ++i)
+                           EXPECT_EQ(static_cast<int>(i), v[i]);
+                       throw;
+                   }
+                   EXPECT_EQ(40u, v.size());
+               });
+}
@@ -0,0 +1,114 @@
+#ifndef VECTOR_INDEXED_ITERATOR_H
+#define VECTOR_INDEXED_ITERATOR_H
+
+#include <cstddef>
+#include <iterator>
+
+// Random-access const_iterator of a container whose elements are not
+// contiguous: it holds the container and an index, and dereferences to
+// (*owner)[index]. Only Owner creates non-singular ones.
+template<typename Owner, typename T>
+class indexed_const_iterator {
+public:
+    typedef T value_type;
+    typedef T const &reference;
+    typedef T const *pointer;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::random_access_iterator_tag iterator_category;
+
+    indexed_const_iterator() noexcept = default;
+
+    reference operator*() const noexcept {
+        return (*owner)[index];
+    }
+
+    pointer operator->() const noexcept {
+        return &(*owner)[index];
+    }
+
+    reference operator[](difference_type n) const noexcept {
+        return (*owner)[index + n];
+    }
+
+    indexed_const_iterator &operator++() noexcept {
+        ++index;
+        return *this;
+    }
+
+    indexed_const_iterator operator++(int) noexcept {
+        indexed_const_iterator result(*this);
+        ++index;
+        return result;
+    }
+
+    indexed_const_iterator &operator--() noexcept {
+        --index;
+        return *this;
+    }
+
+    indexed_const_iterator operator--(int) noexcept {
+        indexed_const_iterator result(*this);
+        --index;
+        return result;
+    }
+
+    indexed_const_iterator &operator+=(difference_type n) noexcept {
+        index += n;
+        return *this;
+    }
+
+    indexed_const_iterator &operator-=(difference_type n) noexcept {
+        index -= n;
+        return *this;
+    }
+
+    friend indexed_const_iterator operator+(indexed_const_iterator p, difference_type n) noexcept {
+        return p += n;
+    }
+
+    friend indexed_const_iterator operator+(difference_type n, indexed_const_iterator p) noexcept {
+        return p += n;
+    }
+
+    friend indexed_const_iterator operator-(indexed_const_iterator p, difference_type n) noexcept {
+        return p -= n;
+    }
+
+    friend difference_type operator-(indexed_const_iterator const &p, indexed_const_iterator const &q) noexcept {
+        return static_cast<difference_type>(p.index - q.index);
+    }
+
+    bool operator==(indexed_const_iterator const &other) const noexcept {
+        return index == other.index;
+    }
+
+    bool operator!=(indexed_const_iterator const &other) const noexcept {
+        return index != other.index;
+    }
+
+    bool operator<(indexed_const_iterator const &other) const noexcept {
+        return index < other.index;
+    }
+
+    bool operator>(indexed_const_iterator const &other) const noexcept {
+        return index > other.index;
+    }
+
+    bool operator<=(indexed_const_iterator const &other) const noexcept {
+        return index <= other.index;
+    }
+
+    bool operator>=(indexed_const_iterator const &other) const noexcept {
+        return index >= other.index;
+    }
+
+private:
+    friend Owner;
+
+    indexed_const_iterator(Owner const *owner, size_t index) noexcept : owner(owner), index(index) {}
+
+    Owner const *owner = nullptr;
+    size_t index = 0;
+};
+
+#endif //VECTOR_INDEXED_ITERATOR_H
@@ -0,0 +1,337 @@
+#ifndef VECTOR_INPLACE_VECTOR_H
+#define VECTOR_INPLACE_VECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "sequence_compare.h"
+#include "vector.h"
+
+// vector of at most N elements, stored inside the object: no heap block, no
+// reference count, no variant. It has vector's interface and iterators;
+// push_back, insert and reserve beyond N throw std::bad_alloc, and
+// try_push_back returns false instead.
+//
+// The storage depends on T. A trivial T lives in a plain array, so the whole
+// container is a literal type and can be filled and read in constant
+// expressions, at the price of value-initializing all N elements. Other
+// types are constructed in raw bytes as they are added. Either way, the
+// container is trivially copyable when T is, and copies only its size()
+// elements otherwise.
+namespace inplace_detail {
+    enum class kind {
+        trivial,
+        trivially_copyable,
+        other,
+    };
+
+    template<typename T>
+    constexpr kind kind_of = std::is_trivial<T>::value ? kind::trivial
+                             : std::is_trivially_copyable<T>::value ? kind::trivially_copyable
+                             : kind::other;
+
+    template<typename T, size_t N, kind = kind_of<T>>
+    struct storage {
+        T elements[N == 0 ? 1 : N] = {};
+        size_t count = 0;
+
+        constexpr T *data() noexcept {
+            return elements;
+        }
+
+        constexpr T const *data() const noexcept {
+            return elements;
+        }
+    };
+
+    template<typename T, size_t N>
+    struct storage<T, N, kind::trivially_copyable> {
+        alignas(T) unsigned char bytes[(N == 0 ? 1 : N) * sizeof(T)];
+        size_t count = 0;
+
+        T *data() noexcept {
+            return reinterpret_cast<T *>(bytes);
+        }
+
+        T const *data() const noexcept {
+            return reinterpret_cast<T const *>(bytes);
+        }
+    };
+
+    // Copies and moves construct the other's elements one by one; assignment
+    // gives the basic guarantee.
+    template<typename T, size_t N>
+    struct storage<T, N, kind::other> : storage<T, N, kind::trivially_copyable> {
+        using storage<T, N, kind::trivially_copyable>::data;
+        using storage<T, N, kind::trivially_copyable>::count;
+
+        storage() noexcept = default;
+
+        storage(storage const &other) {
+            std::uninitialized_copy(other.data(), other.data() + other.count, data());
+            count = other.count;
+        }
+
+        storage(storage &&other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+            std::uninitialized_move(other.data(), other.data() + other.count, data());
+            count = other.count;
+        }
+
+        storage &operator=(storage const &other) {
+            if (this != &other) {
+                assign(other.data(), other.count);
+            }
+            return *this;
+        }
+
+        storage &operator=(storage &&other) noexcept(std::is_nothrow_move_assignable<T>::value &&
+                                                     std::is_nothrow_move_constructible<T>::value) {
+            if (this != &other) {
+                assign(std::make_move_iterator(other.data()), other.count);
+            }
+            return *this;
+        }
+
+        ~storage() {
+            std::destroy(data(), data() + count);
+        }
+
+    private:
+        template<typename It>
+        void assign(It first, size_t n) {
+            size_t common = std::min(count, n);
+            std::copy(first, first + common, data());
+            if (n < count) {
+                std::destroy(data() + n, data() + count);
+                count = n;
+            } else {
+                for (size_t i = common; i != n; ++i) {
+                    new(data() + i) T(first[i]);
+                    count++;
+                }
+            }
+        }
+    };
+}
+
+template<typename T, size_t N>
+class inplace_vector : public sequence_compare<inplace_vector<T, N>> {
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef T const *const_pointer;
+    typedef T &reference;
+    typedef T const &const_reference;
+
+    typedef ::iterator<T> iterator;
+    typedef ::const_iterator<T> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    constexpr inplace_vector() noexcept = default;
+
+    template<typename InputIterator>
+    constexpr inplace_vector(InputIterator first, InputIterator last) {
+        assign(first, last);
+    }
+
+    template<typename InputIterator>
+    constexpr void assign(InputIterator first, InputIterator last) {
+        clear();
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    constexpr reference operator[](size_t i) noexcept {
+        return data()[i];
+    }
+
+    constexpr const_reference operator[](size_t i) const noexcept {
+        return data()[i];
+    }
+
+    constexpr reference front() noexcept {
+        return data()[0];
+    }
+
+    constexpr const_reference front() const noexcept {
+        return data()[0];
+    }
+
+    constexpr reference back() noexcept {
+        return data()[size() - 1];
+    }
+
+    constexpr const_reference back() const noexcept {
+        return data()[size() - 1];
+    }
+
+    constexpr void push_back(const_reference a) {
+        if (!try_push_back(a)) {
+            throw std::bad_alloc();
+        }
+    }
+
+    // Returns false, leaving the vector unchanged, when it holds N elements.
+    constexpr bool try_push_back(const_reference a) {
+        if (s.count == N) {
+            return false;
+        }
+        construct(s.count, a);
+        s.count++;
+        return true;
+    }
+
+    constexpr void pop_back() noexcept {
+        assert(s.count != 0);
+        destroy(--s.count);
+    }
+
+    constexpr pointer data() noexcept {
+        return s.data();
+    }
+
+    constexpr const_pointer data() const noexcept {
+        return s.data();
+    }
+
+    constexpr iterator begin() noexcept {
+        return iterator(data());
+    }
+
+    constexpr const_iterator begin() const noexcept {
+        return const_iterator(const_cast<pointer>(data()));
+    }
+
+    constexpr iterator end() noexcept {
+        return iterator(data() + size());
+    }
+
+    constexpr const_iterator end() const noexcept {
+        return const_iterator(const_cast<pointer>(data()) + size());
+    }
+
+    reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    constexpr bool empty() const noexcept {
+        return s.count == 0;
+    }
+
+    constexpr size_t size() const noexcept {
+        return s.count;
+    }
+
+    static constexpr size_t capacity() noexcept {
+        return N;
+    }
+
+    // Nothing to allocate; only checks that `cap` elements would fit.
+    constexpr void reserve(size_t cap) {
+        if (cap > N) {
+            throw std::bad_alloc();
+        }
+    }
+
+    constexpr void resize(size_t sz, value_type val) {
+        reserve(sz);
+        while (s.count > sz) {
+            pop_back();
+        }
+        while (s.count < sz) {
+            construct(s.count, val);
+            s.count++;
+        }
+    }
+
+    constexpr void clear() noexcept {
+        while (s.count != 0) {
+            pop_back();
+        }
+    }
+
+    // Only the basic guarantee holds if an assignment throws.
+    constexpr void insert(const_iterator pos, T const &val) {
+        auto index = static_cast<size_t>(pos.ptr - data());
+        if (index == size()) {
+            push_back(val);
+            return;
+        }
+        reserve(size() + 1);
+        // val may be an element that the shift overwrites
+        value_type copy(val);
+        pointer first = data();
+        construct(s.count, first[s.count - 1]);
+        s.count++;
+        for (size_t i = s.count - 2; i != index; --i) {
+            first[i] = std::move(first[i - 1]);
+        }
+        first[index] = std::move(copy);
+    }
+
+    constexpr iterator erase(const_iterator pos) {
+        return erase(pos, pos + 1);
+    }
+
+    constexpr iterator erase(const_iterator first, const_iterator last) {
+        auto from = static_cast<size_t>(first.ptr - data());
+        auto n = static_cast<size_t>(last - first);
+        pointer p = data();
+        for (size_t i = from; i + n < s.count; ++i) {
+            p[i] = std::move(p[i + n]);
+        }
+        for (; n != 0; --n) {
+            pop_back();
+        }
+        return begin() + from;
+    }
+
+    void swap(inplace_vector &other) {
+        using std::swap;
+        swap(s, other.s);
+    }
+
+private:
+    constexpr void construct(size_t i, const_reference val) {
+        if constexpr (inplace_detail::kind_of<T> == inplace_detail::kind::trivial) {
+            s.data()[i] = val;
+        } else {
+            new(s.data() + i) T(val);
+        }
+    }
+
+    constexpr void destroy(size_t i) noexcept {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            std::destroy_at(s.data() + i);
+        }
+    }
+
+    inplace_detail::storage<T, N> s;
+};
+
+template<typename T, size_t N>
+void swap(inplace_vector<T, N> &a, inplace_vector<T, N> &b) {
+    a.swap(b);
+}
+
+#endif //VECTOR_INPLACE_VECTOR_H
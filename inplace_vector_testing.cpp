@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "alloc_stats.h"
+#include "counted.h"
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+#include "inplace_vector.h"
+
+namespace
+{
+    struct point
+    {
+        int x = 0;
+        int y = 0;
+    };
+
+    constexpr int constant_sum()
+    {
+        inplace_vector<int, 8> v;
+        for (int i = 1; v.try_push_back(i); ++i)
+        {}
+        v.erase(v.begin());
+        v.insert(v.begin() + 1, 100);
+        v.pop_back();
+        int sum = 0;
+        for (auto it = v.begin(); it != v.end(); ++it)
+            sum += *it;
+        return sum + static_cast<int>(v.size()) * 1000;
+    }
+
+    static_assert(constant_sum() == 2 + 100 + 3 + 4 + 5 + 6 + 7 + 7000);
+    static_assert(std::is_trivially_copyable<inplace_vector<int, 32> >::value);
+    static_assert(std::is_trivially_copyable<inplace_vector<point, 32> >::value);
+    static_assert(!std::is_trivially_copyable<inplace_vector<std::string, 32> >::value);
+    static_assert(sizeof(inplace_vector<int, 32>) == 32 * sizeof(int) + sizeof(size_t));
+    static_assert(std::is_same<inplace_vector<int, 4>::iterator, vector<int>::iterator>::value);
+    static_assert(inplace_vector<int, 4>::capacity() == 4);
+}
+
+TEST(inplace_vector, push_back_and_overflow)
+{
+    alloc_stats_scope s;
+    inplace_vector<int, 32> v;
+    for (int i = 0; i != 32; ++i)
+        v.push_back(i);
+    EXPECT_FALSE(v.try_push_back(32));
+    EXPECT_THROW(v.push_back(32), std::bad_alloc);
+    EXPECT_THROW(v.reserve(33), std::bad_alloc);
+    ASSERT_EQ(32u, v.size());
+    for (int i = 0; i != 32; ++i)
+        EXPECT_EQ(i, v[i]);
+    EXPECT_EQ(0, v.front());
+    EXPECT_EQ(31, v.back());
+
+    inplace_vector<int, 32> copy = v;
+    v.clear();
+    EXPECT_TRUE(v.empty());
+    EXPECT_EQ(32u, copy.size());
+    EXPECT_EQ(0u, s.stats().allocations);
+}
+
+TEST(inplace_vector, strings)
+{
+    inplace_vector<std::string, 8> v;
+    for (int i = 0; i != 5; ++i)
+        v.push_back(std::to_string(i));
+    v.insert(v.begin(), v[4]);
+    v.insert(v.begin() + 3, "x");
+    EXPECT_EQ(7u, v.size());
+    std::vector<std::string> expected = {"4", "0", "1", "x", "2", "3", "4"};
+    EXPECT_TRUE(std::equal(v.begin(), v.end(), expected.begin(), expected.end()));
+
+    v.erase(v.begin() + 1, v.begin() + 3);
+    expected = {"4", "x", "2", "3", "4"};
+    EXPECT_TRUE(std::equal(v.begin(), v.end(), expected.begin(), expected.end()));
+
+    inplace_vector<std::string, 8> copy = v;
+    inplace_vector<std::string, 8> moved = std::move(v);
+    EXPECT_EQ(copy, moved);
+    copy.resize(2, "");
+    EXPECT_LT(copy, moved);
+    moved = copy;
+    EXPECT_EQ(copy, moved);
+    copy.resize(6, "y");
+    EXPECT_EQ("y", copy.back());
+    swap(copy, moved);
+    EXPECT_EQ(6u, moved.size());
+    EXPECT_EQ(2u, copy.size());
+}
+
+TEST(inplace_vector, algorithms)
+{
+    inplace_vector<int, 16> v;
+    for (int i = 0; i != 16; ++i)
+        v.push_back((i * 7) % 16);
+    std::sort(v.begin(), v.end());
+    for (int i = 0; i != 16; ++i)
+        EXPECT_EQ(i, v[i]);
+    EXPECT_EQ(15, *v.rbegin());
+
+    int input[] = {3, 1, 2};
+    inplace_vector<int, 4> w(std::begin(input), std::end(input));
+    EXPECT_EQ(3u, w.size());
+    EXPECT_EQ(2, w.back());
+}
+
+TEST(inplace_vector, comparison)
+{
+    inplace_vector<std::string, 4> a, b;
+    EXPECT_TRUE(a == b);
+    EXPECT_TRUE(a <= b);
+    EXPECT_TRUE(a >= b);
+    a.push_back("x");
+    b.push_back("x");
+    b.push_back("");
+    EXPECT_FALSE(a == b);
+    EXPECT_TRUE(a != b);
+    EXPECT_TRUE(a < b);
+    EXPECT_TRUE(a <= b);
+    EXPECT_FALSE(a > b);
+    EXPECT_FALSE(a >= b);
+    b[0] = "a";
+    EXPECT_TRUE(a > b);
+    EXPECT_TRUE(b <= a);
+}
+
+TEST(inplace_vector, exception_safety)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   inplace_vector<counted, 8> v;
+                   for (int i = 0; i != 4; ++i)
+                       v.push_back(i);
+                   inplace_vector<counted, 8> copy = v;
+                   copy.insert(copy.begin() + 1, copy[3]);
+                   copy.erase(copy.begin());
+                   v = copy;
+                   EXPECT_EQ(4u, v.size());
+                   EXPECT_EQ(3, v[0]);
+               });
+}
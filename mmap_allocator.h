@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include <sys/mman.h>
+
+// Allocator taking memory straight from mmap, so that test bookkeeping
+// neither goes through nor perturbs the instrumented global operator new.
+template <typename T>
+struct mmap_allocator
+{
+    using value_type = T;
+
+    mmap_allocator() = default;
+
+    template <typename U>
+    mmap_allocator(mmap_allocator<U> const&)
+    {}
+
+    T* allocate(size_t n)
+    {
+        void* ptr = mmap(nullptr, n * sizeof(T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+        return reinterpret_cast<T*>(ptr);
+    }
+
+    void deallocate(void* p, std::size_t n)
+    {
+        int r = munmap(p, n * sizeof(T));
+        if (r != 0)
+            std::abort();
+    }
+};
+
+template <typename T, typename U>
+bool operator==(mmap_allocator<T> const&, mmap_allocator<U> const&)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(mmap_allocator<T> const&, mmap_allocator<U> const&)
+{
+    return false;
+}
@@ -0,0 +1,50 @@
+#include "no_alloc.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    thread_local bool forbidden = false;
+    thread_local no_alloc_scope::action current = no_alloc_scope::action::abort_process;
+    thread_local size_t violation_count = 0;
+}
+
+no_alloc_scope::no_alloc_scope(action on_allocation)
+    : was_active(forbidden)
+    , previous(current)
+    , start(violation_count)
+{
+    forbidden = true;
+    current = on_allocation;
+}
+
+no_alloc_scope::~no_alloc_scope()
+{
+    forbidden = was_active;
+    current = previous;
+}
+
+size_t no_alloc_scope::violations() const
+{
+    return violation_count - start;
+}
+
+bool no_alloc_scope::active()
+{
+    return forbidden;
+}
+
+// Reports through stdio, which does not allocate for an unbuffered stderr.
+void no_alloc_scope::check(size_t size) noexcept
+{
+    if (!forbidden)
+        return;
+
+    ++violation_count;
+    forbidden = false;
+    std::fprintf(stderr, "allocation of %zu bytes inside no_alloc_scope\n", size);
+    forbidden = true;
+    if (current == action::abort_process)
+        std::abort();
+}
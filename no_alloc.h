@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+// Forbids global operator new on the current thread while alive, so that a
+// real-time section can prove it never allocates. The check is called from
+// the replacement operators in fault_injection.cpp and costs a thread-local
+// load outside of a scope.
+//
+// By default an allocation inside the scope prints its size and aborts; with
+// action::log it is printed, counted and allowed to proceed. Scopes nest, and
+// the innermost one decides.
+struct no_alloc_scope
+{
+    enum class action
+    {
+        abort_process,
+        log,
+    };
+
+    explicit no_alloc_scope(action on_allocation = action::abort_process);
+    no_alloc_scope(no_alloc_scope const&) = delete;
+    no_alloc_scope& operator=(no_alloc_scope const&) = delete;
+    ~no_alloc_scope();
+
+    // Allocations made on this thread since the scope was entered.
+    size_t violations() const;
+
+    static bool active();
+    static void check(size_t size) noexcept;
+
+private:
+    bool was_active;
+    action previous;
+    size_t start;
+};
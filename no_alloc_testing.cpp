@@ -0,0 +1,158 @@
+#include <string>
+
+#include "alloc_stats.h"
+#include "counted.h"
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+#include "no_alloc.h"
+#include "vector.h"
+
+namespace
+{
+    void* volatile sink;
+
+    void allocate_and_free()
+    {
+        sink = operator new(16);
+        operator delete(sink);
+    }
+}
+
+TEST(no_alloc_scope, logs_allocations)
+{
+    EXPECT_FALSE(no_alloc_scope::active());
+    {
+        no_alloc_scope outer(no_alloc_scope::action::log);
+        EXPECT_TRUE(no_alloc_scope::active());
+        allocate_and_free();
+        {
+            no_alloc_scope inner(no_alloc_scope::action::log);
+            allocate_and_free();
+            EXPECT_EQ(1u, inner.violations());
+        }
+        EXPECT_EQ(2u, outer.violations());
+    }
+    EXPECT_FALSE(no_alloc_scope::active());
+    allocate_and_free();
+}
+
+TEST(no_alloc_scope, aborts_by_default)
+{
+    EXPECT_DEATH(
+        {
+            no_alloc_scope guard;
+            allocate_and_free();
+        },
+        "allocation of 16 bytes inside no_alloc_scope");
+}
+
+TEST(no_alloc_scope, try_push_back_never_allocates)
+{
+    vector<std::string> v;
+    v.reserve_exact(100);
+    EXPECT_EQ(100u, v.capacity());
+
+    alloc_stats_scope s;
+    {
+        no_alloc_scope guard(no_alloc_scope::action::log);
+        for (int i = 0; i != 100; ++i)
+            EXPECT_TRUE(v.try_push_back(std::string()));
+        EXPECT_FALSE(v.try_push_back(std::string()));
+        v.pop_back();
+        EXPECT_TRUE(v.try_push_back(v[0]));
+        EXPECT_EQ(0u, guard.violations());
+    }
+    EXPECT_EQ(0u, s.stats().allocations);
+    EXPECT_EQ(100u, v.size());
+}
+
+TEST(no_alloc_scope, try_push_back_refuses_to_detach)
+{
+    vector<int> v;
+    v.reserve_exact(4);
+    v.push_back(1);
+    vector<int> copy = v;
+
+    alloc_stats_scope s;
+    {
+        no_alloc_scope guard;
+        EXPECT_FALSE(v.try_push_back(2));
+    }
+    EXPECT_EQ(1u, v.size());
+
+    v.reserve_exact(4);
+    EXPECT_EQ(1u, s.stats().allocations);
+    {
+        no_alloc_scope guard;
+        EXPECT_TRUE(v.try_push_back(2));
+        EXPECT_TRUE(v.try_push_back(3));
+    }
+    EXPECT_EQ(3u, v.size());
+    EXPECT_EQ(1u, copy.size());
+}
+
+TEST(no_alloc_scope, inline_element)
+{
+    vector<int> v;
+    alloc_stats_scope s;
+    v.reserve_exact(1);
+    {
+        no_alloc_scope guard;
+        EXPECT_TRUE(v.try_push_back(1));
+        EXPECT_FALSE(v.try_push_back(2));
+    }
+    EXPECT_EQ(0u, s.stats().allocations);
+    ASSERT_EQ(1u, v.size());
+
+    v.reserve_exact(3);
+    EXPECT_EQ(3u, v.capacity());
+    {
+        no_alloc_scope guard;
+        EXPECT_TRUE(v.try_push_back(2));
+        EXPECT_TRUE(v.try_push_back(3));
+        EXPECT_FALSE(v.try_push_back(4));
+    }
+    EXPECT_EQ(1, v[0]);
+    EXPECT_EQ(3, v[2]);
+}
+
+TEST(no_alloc_scope, reserve_exact)
+{
+    vector<int> v;
+    for (int i = 0; i != 10; ++i)
+        v.push_back(i);
+    ASSERT_EQ(16u, v.capacity());
+
+    alloc_stats_scope s;
+    v.reserve_exact(12);
+    EXPECT_EQ(16u, v.capacity());
+    EXPECT_EQ(0u, s.stats().allocations);
+    v.reserve_exact(17);
+    EXPECT_EQ(17u, v.capacity());
+    v.reserve_exact(3);
+    EXPECT_EQ(17u, v.capacity());
+    EXPECT_EQ(1u, s.stats().allocations);
+    for (int i = 0; i != 10; ++i)
+        EXPECT_EQ(i, v[i]);
+}
+
+TEST(no_alloc_scope, try_push_back_strong_guarantee)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   vector<counted> v;
+                   v.reserve_exact(3);
+                   v.push_back(1);
+                   try
+                   {
+                       EXPECT_TRUE(v.try_push_back(2));
+                   }
+                   catch (...)
+                   {
+                       EXPECT_EQ(1u, v.size());
+                       throw;
+                   }
+                   EXPECT_EQ(2u, v.size());
+               });
+}
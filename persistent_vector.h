@@ -0,0 +1,546 @@
+#ifndef VECTOR_PERSISTENT_VECTOR_H
+#define VECTOR_PERSISTENT_VECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "vector.h"
+
+// Vector whose versions share structure: a 32-way trie of leaves of 32
+// elements, plus a separate tail leaf holding the last 1 to 32 of them.
+//
+// Every node is reference counted, and a write copies only the nodes on its
+// path that are shared with another version, the same copy-if-shared rule
+// vector applies to its whole block. So set() and push_back() on a
+// persistent_vector cost O(log32 n) and leave the original untouched, while
+// a transient_vector, which is rarely shared, updates its own nodes in place.
+// Appends go to the tail and reach the trie once every 32 elements.
+//
+// As with vector, the reference counts are plain integers: versions that
+// share nodes must not be used from different threads at the same time.
+
+template<typename T>
+class transient_vector;
+
+namespace persistent_detail {
+    constexpr unsigned bits = 5;
+    constexpr size_t width = size_t(1) << bits;
+    constexpr size_t mask = width - 1;
+
+    struct node {
+        size_t refs = 1;
+    };
+
+    struct branch : node {
+        node *children[width] = {};
+    };
+
+    template<typename T>
+    struct leaf : node {
+        size_t count = 0;
+        alignas(T) unsigned char storage[width * sizeof(T)];
+
+        T *items() noexcept {
+            return std::launder(reinterpret_cast<T *>(storage));
+        }
+
+        T const *items() const noexcept {
+            return std::launder(reinterpret_cast<T const *>(storage));
+        }
+
+        ~leaf() {
+            std::destroy(items(), items() + count);
+        }
+    };
+
+    // The shared core of persistent_vector and transient_vector. Mutations
+    // copy the shared nodes on their path; on an exception the trie is left
+    // as it was, apart from nodes that were already made unshared.
+    template<typename T>
+    class trie {
+    public:
+        trie() noexcept = default;
+
+        trie(trie const &other) noexcept
+                : count(other.count), shift(other.shift), root(other.root), tail(other.tail) {
+            add_ref(root);
+            add_ref(tail);
+        }
+
+        trie &operator=(trie const &other) noexcept {
+            trie copy(other);
+            swap(copy);
+            return *this;
+        }
+
+        ~trie() {
+            release(root, shift);
+            release(tail, 0);
+        }
+
+        void swap(trie &other) noexcept {
+            std::swap(count, other.count);
+            std::swap(shift, other.shift);
+            std::swap(root, other.root);
+            std::swap(tail, other.tail);
+        }
+
+        size_t size() const noexcept {
+            return count;
+        }
+
+        // The leaf holding element i; elements of a leaf are contiguous.
+        leaf<T> const *leaf_for(size_t i) const noexcept {
+            if (i >= tail_offset()) {
+                return static_cast<leaf<T> const *>(tail);
+            }
+            node const *n = root;
+            for (unsigned level = shift; level > 0; level -= bits) {
+                n = static_cast<branch const *>(n)->children[(i >> level) & mask];
+            }
+            return static_cast<leaf<T> const *>(n);
+        }
+
+        T const &operator[](size_t i) const noexcept {
+            return leaf_for(i)->items()[i & mask];
+        }
+
+        void push_back(T const &value) {
+            if (count - tail_offset() < width) {
+                leaf<T> *t = tail == nullptr ? new_leaf(tail) : unique_leaf(tail);
+                new(t->items() + t->count) T(value);
+                t->count++;
+                count++;
+                return;
+            }
+            // the tail is full: it moves into the trie and a new one starts
+            auto fresh = new leaf<T>;
+            try {
+                new(fresh->items()) T(value);
+                fresh->count = 1;
+                push_tail();
+            } catch (...) {
+                delete fresh;
+                throw;
+            }
+            release(tail, 0);
+            tail = fresh;
+            count++;
+        }
+
+        void set(size_t i, T const &value) {
+            assert(i < count);
+            if (i >= tail_offset()) {
+                unique_leaf(tail)->items()[i & mask] = value;
+                return;
+            }
+            node **slot = &root;
+            for (unsigned level = shift; level > 0; level -= bits) {
+                slot = &unique_branch(*slot)->children[(i >> level) & mask];
+            }
+            unique_leaf(*slot)->items()[i & mask] = value;
+        }
+
+        void pop_back() {
+            assert(count != 0);
+            if (count - tail_offset() > 1 || count == 1) {
+                leaf<T> *t = unique_leaf(tail);
+                std::destroy_at(t->items() + --t->count);
+                count--;
+                return;
+            }
+            // the tail empties: the last leaf of the trie becomes the tail
+            node *last = const_cast<leaf<T> *>(leaf_for(count - 2));
+            add_ref(last);
+            try {
+                pop_tail(root, shift);
+            } catch (...) {
+                release(last, 0);
+                throw;
+            }
+            if (shift > bits && static_cast<branch *>(root)->children[1] == nullptr) {
+                node *child = static_cast<branch *>(root)->children[0];
+                add_ref(child);
+                release(root, shift);
+                root = child;
+                shift -= bits;
+            }
+            release(tail, 0);
+            tail = last;
+            count--;
+        }
+
+    private:
+        // Index of the first element in the tail.
+        size_t tail_offset() const noexcept {
+            return count < width ? 0 : ((count - 1) >> bits) << bits;
+        }
+
+        static void add_ref(node *n) noexcept {
+            if (n != nullptr) {
+                n->refs++;
+            }
+        }
+
+        // Drops a reference to the subtree of height `level` rooted at n.
+        static void release(node *n, unsigned level) noexcept {
+            if (n == nullptr || --n->refs != 0) {
+                return;
+            }
+            if (level == 0) {
+                delete static_cast<leaf<T> *>(n);
+                return;
+            }
+            auto b = static_cast<branch *>(n);
+            for (node *child : b->children) {
+                release(child, level - bits);
+            }
+            delete b;
+        }
+
+        static leaf<T> *new_leaf(node *&slot) {
+            auto l = new leaf<T>;
+            slot = l;
+            return l;
+        }
+
+        static branch *unique_branch(node *&slot) {
+            auto b = static_cast<branch *>(slot);
+            if (b->refs == 1) {
+                return b;
+            }
+            auto copy = new branch(*b);
+            copy->refs = 1;
+            for (node *child : copy->children) {
+                add_ref(child);
+            }
+            b->refs--;
+            slot = copy;
+            return copy;
+        }
+
+        static leaf<T> *unique_leaf(node *&slot) {
+            auto l = static_cast<leaf<T> *>(slot);
+            if (l->refs == 1) {
+                return l;
+            }
+            auto copy = new leaf<T>;
+            try {
+                for (; copy->count != l->count; copy->count++) {
+                    new(copy->items() + copy->count) T(l->items()[copy->count]);
+                }
+            } catch (...) {
+                delete copy;
+                throw;
+            }
+            l->refs--;
+            slot = copy;
+            return copy;
+        }
+
+        // A chain of single-child branches of height `level` down to leaf l.
+        static node *new_path(unsigned level, node *l) {
+            add_ref(l);
+            node *result = l;
+            for (unsigned at = bits; at <= level; at += bits) {
+                branch *b;
+                try {
+                    b = new branch;
+                } catch (...) {
+                    release(result, at - bits);
+                    throw;
+                }
+                b->children[0] = result;
+                result = b;
+            }
+            return result;
+        }
+
+        // Links the full tail into the trie, as the leaf for indices up to
+        // count - 1, taking a reference of its own.
+        void push_tail() {
+            if (root == nullptr) {
+                root = new_path(shift, tail);
+                return;
+            }
+            if ((count >> bits) > (size_t(1) << shift)) {
+                auto top = new branch;
+                try {
+                    top->children[1] = new_path(shift, tail);
+                } catch (...) {
+                    delete top;
+                    throw;
+                }
+                top->children[0] = root;
+                root = top;
+                shift += bits;
+                return;
+            }
+            push_tail_into(root, shift);
+        }
+
+        void push_tail_into(node *&slot, unsigned level) {
+            node *&child = unique_branch(slot)->children[((count - 1) >> level) & mask];
+            if (level == bits) {
+                add_ref(tail);
+                child = tail;
+            } else if (child != nullptr) {
+                push_tail_into(child, level - bits);
+            } else {
+                child = new_path(level - bits, tail);
+            }
+        }
+
+        // Unlinks the leaf for index count - 2, the last one in the trie,
+        // dropping the branches left empty.
+        void pop_tail(node *&slot, unsigned level) {
+            size_t last = count - 2;
+            if ((last & ((size_t(1) << (level + bits)) - 1)) < width) {
+                // the leaf is the only one below slot
+                release(slot, level);
+                slot = nullptr;
+                return;
+            }
+            node *&child = unique_branch(slot)->children[(last >> level) & mask];
+            if (level == bits) {
+                release(child, 0);
+                child = nullptr;
+            } else {
+                pop_tail(child, level - bits);
+            }
+        }
+
+        size_t count = 0;
+        unsigned shift = bits;
+        // null while every element fits in the tail
+        node *root = nullptr;
+        node *tail = nullptr;
+    };
+
+    template<typename T>
+    class const_iterator {
+    public:
+        typedef T value_type;
+        typedef T const &reference;
+        typedef T const *pointer;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::forward_iterator_tag iterator_category;
+
+        const_iterator() noexcept = default;
+
+        const_iterator(trie<T> const *owner, size_t index) noexcept : owner(owner), index(index) {
+            if (index < owner->size()) {
+                items = owner->leaf_for(index)->items();
+            }
+        }
+
+        reference operator*() const noexcept {
+            return items[index & mask];
+        }
+
+        pointer operator->() const noexcept {
+            return items + (index & mask);
+        }
+
+        const_iterator &operator++() noexcept {
+            if ((++index & mask) == 0 && index < owner->size()) {
+                items = owner->leaf_for(index)->items();
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) noexcept {
+            const_iterator result(*this);
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const_iterator const &other) const noexcept {
+            return index == other.index;
+        }
+
+        bool operator!=(const_iterator const &other) const noexcept {
+            return index != other.index;
+        }
+
+    private:
+        trie<T> const *owner = nullptr;
+        size_t index = 0;
+        T const *items = nullptr;
+    };
+
+    // Calls f(data, size) for each leaf in order.
+    template<typename T, typename F>
+    void for_each_chunk(trie<T> const &t, F f) {
+        for (size_t i = 0; i < t.size(); i += width) {
+            f(t.leaf_for(i)->items(), std::min(width, t.size() - i));
+        }
+    }
+
+    template<typename T>
+    vector<T> to_vector(trie<T> const &t) {
+        vector<T> result;
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            result.overwrite(t.size(), [&t](T *out) {
+                for_each_chunk(t, [&out](T const *data, size_t n) {
+                    std::memcpy(static_cast<void *>(out), data, n * sizeof(T));
+                    out += n;
+                });
+            });
+        } else {
+            result.reserve(t.size());
+            for_each_chunk(t, [&result](T const *data, size_t n) {
+                for (size_t i = 0; i != n; ++i) {
+                    result.push_back(data[i]);
+                }
+            });
+        }
+        return result;
+    }
+}
+
+// Immutable value: the modifiers return a new version that shares every
+// node off the modified path with this one. Copies are O(1).
+template<typename T>
+class persistent_vector {
+public:
+    typedef T value_type;
+    typedef T const &const_reference;
+    typedef persistent_detail::const_iterator<T> const_iterator;
+
+    persistent_vector() noexcept = default;
+
+    explicit persistent_vector(vector<T> const &v) {
+        for (T const *p = v.data(), *last = p + v.size(); p != last; ++p) {
+            elements.push_back(*p);
+        }
+    }
+
+    size_t size() const noexcept {
+        return elements.size();
+    }
+
+    bool empty() const noexcept {
+        return elements.size() == 0;
+    }
+
+    const_reference operator[](size_t i) const noexcept {
+        return elements[i];
+    }
+
+    const_reference back() const noexcept {
+        return elements[elements.size() - 1];
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(&elements, 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(&elements, elements.size());
+    }
+
+    persistent_vector push_back(const_reference value) const {
+        persistent_vector result(*this);
+        result.elements.push_back(value);
+        return result;
+    }
+
+    persistent_vector set(size_t i, const_reference value) const {
+        persistent_vector result(*this);
+        result.elements.set(i, value);
+        return result;
+    }
+
+    persistent_vector pop_back() const {
+        persistent_vector result(*this);
+        result.elements.pop_back();
+        return result;
+    }
+
+    // Calls f(data, size) for each run of up to 32 contiguous elements.
+    template<typename F>
+    void for_each_chunk(F f) const {
+        persistent_detail::for_each_chunk(elements, f);
+    }
+
+    vector<T> to_vector() const {
+        return persistent_detail::to_vector(elements);
+    }
+
+    // A mutable copy for a batch of updates, see transient_vector.
+    transient_vector<T> transient() const {
+        return transient_vector<T>(*this);
+    }
+
+private:
+    friend class transient_vector<T>;
+
+    persistent_detail::trie<T> elements;
+};
+
+// Mutable counterpart of persistent_vector for batches of updates. Nodes it
+// shares with persistent versions are copied on the first write to them,
+// after which that write and later ones to the same nodes happen in place.
+// persistent() hands out an O(1) snapshot and the transient stays usable:
+// its next writes copy the nodes now shared with the snapshot.
+template<typename T>
+class transient_vector {
+public:
+    typedef T value_type;
+    typedef T const &const_reference;
+    typedef persistent_detail::const_iterator<T> const_iterator;
+
+    transient_vector() noexcept = default;
+
+    explicit transient_vector(persistent_vector<T> const &v) noexcept : elements(v.elements) {}
+
+    size_t size() const noexcept {
+        return elements.size();
+    }
+
+    bool empty() const noexcept {
+        return elements.size() == 0;
+    }
+
+    const_reference operator[](size_t i) const noexcept {
+        return elements[i];
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(&elements, 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(&elements, elements.size());
+    }
+
+    void push_back(const_reference value) {
+        elements.push_back(value);
+    }
+
+    void set(size_t i, const_reference value) {
+        elements.set(i, value);
+    }
+
+    void pop_back() {
+        elements.pop_back();
+    }
+
+    persistent_vector<T> persistent() const noexcept {
+        persistent_vector<T> result;
+        result.elements = elements;
+        return result;
+    }
+
+private:
+    persistent_detail::trie<T> elements;
+};
+
+#endif //VECTOR_PERSISTENT_VECTOR_H
@@ -0,0 +1,176 @@
+#include <string>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "counted.h"
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+#include "persistent_vector.h"
+
+namespace
+{
+    template <typename T>
+    void expect_equal(std::vector<T> const& expected, persistent_vector<T> const& actual)
+    {
+        ASSERT_EQ(expected.size(), actual.size());
+        for (size_t i = 0; i != expected.size(); ++i)
+            ASSERT_EQ(expected[i], actual[i]) << "at " << i;
+    }
+}
+
+TEST(persistent_vector, push_back_and_pop_back)
+{
+    // crosses the first three heights of the trie
+    const size_t n = 32 * 32 * 32 + 100;
+    std::vector<size_t> expected;
+    persistent_vector<size_t> v;
+    for (size_t i = 0; i != n; ++i)
+    {
+        v = v.push_back(i * 7);
+        expected.push_back(i * 7);
+    }
+    expect_equal(expected, v);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), v.begin(), v.end()));
+
+    while (!v.empty())
+    {
+        v = v.pop_back();
+        expected.pop_back();
+        if (expected.size() % 29 == 0 || expected.size() < 70)
+            expect_equal(expected, v);
+        else
+            ASSERT_EQ(expected.size(), v.size());
+    }
+    v = v.push_back(1);
+    EXPECT_EQ(1u, v[0]);
+}
+
+TEST(persistent_vector, versions_are_independent)
+{
+    std::vector<persistent_vector<int>> versions(1);
+    std::vector<std::vector<int>> expected(1);
+    for (int step = 0; step != 3000; ++step)
+    {
+        persistent_vector<int> const& last = versions.back();
+        std::vector<int> next = expected.back();
+        if (step % 3 == 2 && !next.empty())
+        {
+            size_t i = static_cast<size_t>(step * 31) % next.size();
+            next[i] = -step;
+            versions.push_back(last.set(i, -step));
+        }
+        else if (step % 7 == 6)
+        {
+            next.pop_back();
+            versions.push_back(last.pop_back());
+        }
+        else
+        {
+            next.push_back(step);
+            versions.push_back(last.push_back(step));
+        }
+        expected.push_back(next);
+    }
+    for (size_t k = 0; k < versions.size(); k += 97)
+        expect_equal(expected[k], versions[k]);
+    expect_equal(expected.back(), versions.back());
+}
+
+TEST(persistent_vector, set_copies_one_path)
+{
+    transient_vector<int> t;
+    for (int i = 0; i != 100000; ++i)
+        t.push_back(i);
+    persistent_vector<int> original = t.persistent();
+
+    alloc_stats_scope s;
+    persistent_vector<int> changed = original.set(1234, -1);
+    // three branches and a leaf
+    EXPECT_EQ(4u, s.stats().allocations);
+    EXPECT_EQ(1234, original[1234]);
+    EXPECT_EQ(-1, changed[1234]);
+}
+
+TEST(persistent_vector, transient_updates_in_place)
+{
+    transient_vector<int> t;
+    for (int i = 0; i != 5000; ++i)
+        t.push_back(i);
+    persistent_vector<int> snapshot = t.persistent();
+
+    // the first writes copy the path to element 100 and the tail
+    t.set(100, -100);
+    t.pop_back();
+    alloc_stats_scope s;
+    for (size_t i = 96; i != 128; ++i)
+        t.set(i, -1);
+    EXPECT_EQ(0u, s.stats().allocations);
+    EXPECT_EQ(-1, t[100]);
+    EXPECT_EQ(100, snapshot[100]);
+
+    for (int i = 0; i != 6; ++i)
+        t.pop_back();
+    EXPECT_EQ(0u, s.stats().allocations);
+    EXPECT_EQ(4993u, t.size());
+    EXPECT_EQ(5000u, snapshot.size());
+}
+
+TEST(persistent_vector, converts_to_and_from_vector)
+{
+    vector<std::string> words;
+    for (int i = 0; i != 100; ++i)
+        words.push_back(std::to_string(i));
+    persistent_vector<std::string> p(words);
+    ASSERT_EQ(100u, p.size());
+    EXPECT_EQ("42", p[42]);
+    EXPECT_EQ(words, p.set(5, "5").to_vector());
+
+    vector<int> numbers;
+    for (int i = 0; i != 1000; ++i)
+        numbers.push_back(i);
+    persistent_vector<int> q(numbers);
+    alloc_stats_scope s;
+    vector<int> back = q.to_vector();
+    EXPECT_EQ(1u, s.stats().allocations);
+    EXPECT_EQ(numbers, back);
+
+    size_t chunks = 0;
+    q.for_each_chunk([&](int const* data, size_t n)
+                     {
+                         EXPECT_EQ(static_cast<int>(32 * chunks), data[0]);
+                         EXPECT_EQ(chunks == 31 ? 8u : 32u, n);
+                         ++chunks;
+                     });
+    EXPECT_EQ(32u, chunks);
+}
+
+TEST(persistent_vector, strong_guarantee)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   persistent_vector<counted> v;
+                   for (int i = 0; i != 66; ++i)
+                       v = v.push_back(i);
+                   transient_vector<counted> t = v.transient();
+                   try
+                   {
+                       persistent_vector<counted> w = v.set(3, -3).push_back(66).pop_back().pop_back().pop_back();
+                       t.set(40, -40);
+                       t.pop_back();
+                       t.pop_back();
+                       t.push_back(100);
+                       EXPECT_EQ(-3, w[3]);
+                       EXPECT_EQ(64u, w.size());
+                       EXPECT_EQ(-40, t[40]);
+                       EXPECT_EQ(100, t[64]);
+                   }
+                   catch (...)
+                   {
+                       ASSERT_EQ(66u, v.size());
+                       for (int i = 0; i != 66; ++i)
+                           ASSERT_EQ(i, v[i]);
+                       throw;
+                   }
+               });
+}
@@ -0,0 +1,198 @@
+#ifndef VECTOR_RECYCLING_CACHE_H
+#define VECTOR_RECYCLING_CACHE_H
+
+#include <cstddef>
+
+#include "vector.h"
+
+// Per-thread cache of freed heap blocks, for vectors instantiated with
+// recycling_vector_policy:
+//
+//     vector<int, recycling_vector_policy<>> v;
+//     vector<int, recycling_vector_policy<pooled_vector_policy>> w;
+//
+// A block that vector frees is parked in the freeing thread's cache instead
+// of going back to Base's allocator, and the next allocation of the same
+// bucket on that thread takes it back. That is the common "build a vector,
+// hand it on, drop it, build the next one" loop; in steady state it leaves
+// the allocator alone.
+//
+// Buckets are a quarter of a power of two wide. Every block is allocated
+// with its bucket's size, so any parked block of the bucket fits, wasting at
+// most a quarter of it. A thread parks at most its limit of bytes, 1 MiB by
+// default, and frees whatever does not fit through Base. Its parked blocks
+// are released when it exits; a thread that frees without ever allocating
+// through the cache parks nothing. The hooks other than allocation are
+// Base's, so this composes with the counting and tracing policies.
+//
+// Only blocks released in place, within release_block on the thread that
+// dropped the last reference, are parked. A block whose release Base hands
+// to another thread, as deferred_vector_policy does, goes back to Base's
+// allocator on that thread whichever way the two policies are nested, and
+// never fills the cache of a thread that does not build vectors.
+struct recycling_stats {
+    // allocations served from the cache, and those that went to the allocator
+    size_t hits = 0;
+    size_t misses = 0;
+    // frees that parked a block, and those that went to the allocator
+    size_t parked = 0;
+    size_t released = 0;
+
+    double hit_rate() const noexcept {
+        return hits + misses == 0 ? 0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+    }
+};
+
+namespace recycle_detail {
+    constexpr size_t min_block = 32;
+    constexpr size_t bucket_count = 4 * 64;
+
+    constexpr size_t floor_log2(size_t n) noexcept {
+#if defined(__GNUC__)
+        return 8 * sizeof(unsigned long long) - 1 - static_cast<size_t>(__builtin_clzll(n));
+#else
+        size_t result = 0;
+        while (n >>= 1) {
+            result++;
+        }
+        return result;
+#endif
+    }
+
+    // Sizes in (2^m, 2^(m+1)] round up to a multiple of 2^(m-2).
+    constexpr size_t step_log2(size_t size) noexcept {
+        return floor_log2((size < min_block ? min_block : size) - 1) - 2;
+    }
+
+    constexpr size_t rounded(size_t size) noexcept {
+        size_t e = step_log2(size);
+        return ((((size < min_block ? min_block : size) - 1) >> e) + 1) << e;
+    }
+
+    constexpr size_t bucket_of(size_t size) noexcept {
+        size_t e = step_log2(size);
+        return 4 * e + (rounded(size) >> e) - 5;
+    }
+
+    struct free_block {
+        free_block *next;
+    };
+
+    // Constant-initialized and trivially destructible, so that it can be
+    // used during thread exit, after the cache has been emptied.
+    struct cache_state {
+        free_block *heads[bucket_count];
+        size_t parked_bytes;
+        size_t limit;
+        // nesting of release_block calls on this thread
+        size_t releasing;
+        recycling_stats stats;
+        bool armed;
+        bool closed;
+    };
+
+    template<typename Base>
+    struct cache {
+        static cache_state &state() noexcept {
+            thread_local cache_state s{{}, 0, 1 << 20, 0, {}, false, false};
+            return s;
+        }
+
+        static void release_all() noexcept {
+            cache_state &s = state();
+            for (size_t b = 0; b != bucket_count; ++b) {
+                while (free_block *block = s.heads[b]) {
+                    s.heads[b] = block->next;
+                    Base::deallocate_block(block, bucket_size(b));
+                }
+            }
+            s.parked_bytes = 0;
+        }
+
+        static size_t bucket_size(size_t b) noexcept {
+            return (b % 4 + 5) << (b / 4);
+        }
+
+        // Registers the release of the parked blocks at thread exit; until
+        // then, frees are not parked.
+        static void arm() {
+            struct closer {
+                ~closer() {
+                    release_all();
+                    state().closed = true;
+                }
+            };
+            thread_local closer c;
+            (void) c;
+            state().armed = true;
+        }
+    };
+}
+
+template<typename Base = default_vector_policy>
+struct recycling_vector_policy : Base {
+    static void *allocate_block(size_t size) {
+        typedef recycle_detail::cache<Base> cache;
+        recycle_detail::cache_state &s = cache::state();
+        size_t b = recycle_detail::bucket_of(size);
+        if (recycle_detail::free_block *block = s.heads[b]) {
+            s.heads[b] = block->next;
+            s.parked_bytes -= recycle_detail::rounded(size);
+            s.stats.hits++;
+            return block;
+        }
+        if (!s.armed && !s.closed) {
+            cache::arm();
+        }
+        void *block = Base::allocate_block(recycle_detail::rounded(size));
+        s.stats.misses++;
+        return block;
+    }
+
+    static void deallocate_block(void *block, size_t size) noexcept {
+        recycle_detail::cache_state &s = recycle_detail::cache<Base>::state();
+        size_t bytes = recycle_detail::rounded(size);
+        if (s.releasing == 0 || !s.armed || s.closed || s.parked_bytes + bytes > s.limit) {
+            s.stats.released++;
+            Base::deallocate_block(block, bytes);
+            return;
+        }
+        size_t b = recycle_detail::bucket_of(size);
+        auto parked = static_cast<recycle_detail::free_block *>(block);
+        parked->next = s.heads[b];
+        s.heads[b] = parked;
+        s.parked_bytes += bytes;
+        s.stats.parked++;
+    }
+
+    // Frees that release runs before Base's release_block returns may park
+    // their block; any other is on a thread that did not drop the vector.
+    static void release_block(void *block, size_t size, void (*release)(void *) noexcept) noexcept {
+        recycle_detail::cache_state &s = recycle_detail::cache<Base>::state();
+        s.releasing++;
+        Base::release_block(block, size, release);
+        s.releasing--;
+    }
+
+    // Counters of the calling thread.
+    static recycling_stats thread_stats() noexcept {
+        return recycle_detail::cache<Base>::state().stats;
+    }
+
+    // Bytes the calling thread may keep parked; lowering it takes effect as
+    // blocks are reused, or at once with trim().
+    static void set_thread_limit(size_t bytes) noexcept {
+        recycle_detail::cache<Base>::state().limit = bytes;
+    }
+
+    static size_t thread_parked_bytes() noexcept {
+        return recycle_detail::cache<Base>::state().parked_bytes;
+    }
+
+    // Frees every block the calling thread has parked.
+    static void trim() noexcept {
+        recycle_detail::cache<Base>::release_all();
+    }
+};
+
+#endif //VECTOR_RECYCLING_CACHE_H
@@ -0,0 +1,142 @@
+#include <thread>
+
+#include "alloc_stats.h"
+#include "block_pool.h"
+#include "counted.h"
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+#include "recycling_cache.h"
+#include "vector_stats.h"
+
+typedef recycling_vector_policy<> recycling;
+typedef vector<int, recycling> recycled_vector;
+
+namespace
+{
+    recycling_stats operator-(recycling_stats a, recycling_stats const& b)
+    {
+        a.hits -= b.hits;
+        a.misses -= b.misses;
+        a.parked -= b.parked;
+        a.released -= b.released;
+        return a;
+    }
+
+    template <typename V>
+    void build_and_drop(size_t n)
+    {
+        V v;
+        for (size_t i = 0; i != n; ++i)
+            v.push_back(static_cast<int>(i));
+        V copy = v;
+        copy[0] = 1;
+    }
+}
+
+TEST(recycling_cache, buckets)
+{
+    using namespace recycle_detail;
+    EXPECT_EQ(32u, rounded(1));
+    EXPECT_EQ(32u, rounded(32));
+    EXPECT_EQ(40u, rounded(33));
+    EXPECT_EQ(64u, rounded(57));
+    EXPECT_EQ(80u, rounded(65));
+    for (size_t size = 1; size < 100000; size += 7)
+    {
+        size_t r = rounded(size);
+        ASSERT_GE(r, size);
+        ASSERT_LE(r - size, std::max<size_t>(size / 4, min_block));
+        ASSERT_EQ(r, cache<default_vector_policy>::bucket_size(bucket_of(size)));
+    }
+}
+
+TEST(recycling_cache, steady_state_does_not_allocate)
+{
+    recycling::trim();
+    build_and_drop<recycled_vector>(100);
+    recycling_stats before = recycling::thread_stats();
+
+    alloc_stats_scope s;
+    for (int round = 0; round != 1000; ++round)
+        build_and_drop<recycled_vector>(100);
+    EXPECT_EQ(0u, s.stats().allocations);
+
+    recycling_stats delta = recycling::thread_stats() - before;
+    EXPECT_EQ(0u, delta.misses);
+    EXPECT_EQ(0u, delta.released);
+    EXPECT_EQ(delta.hits, delta.parked);
+    EXPECT_DOUBLE_EQ(1.0, delta.hit_rate());
+}
+
+TEST(recycling_cache, limit_and_trim)
+{
+    recycling::trim();
+    EXPECT_EQ(0u, recycling::thread_parked_bytes());
+    build_and_drop<recycled_vector>(1000);
+    EXPECT_GT(recycling::thread_parked_bytes(), 0u);
+
+    recycling::trim();
+    EXPECT_EQ(0u, recycling::thread_parked_bytes());
+
+    recycling::set_thread_limit(0);
+    recycling_stats before = recycling::thread_stats();
+    build_and_drop<recycled_vector>(1000);
+    recycling_stats delta = recycling::thread_stats() - before;
+    EXPECT_EQ(0u, delta.hits);
+    EXPECT_EQ(0u, delta.parked);
+    EXPECT_EQ(delta.misses, delta.released);
+    EXPECT_EQ(0u, recycling::thread_parked_bytes());
+    recycling::set_thread_limit(1 << 20);
+}
+
+TEST(recycling_cache, threads)
+{
+    // a thread parks blocks once it has allocated through the cache
+    build_and_drop<recycled_vector>(2);
+    recycled_vector from_thread;
+    std::thread t([&]
+                  {
+                      for (int round = 0; round != 10; ++round)
+                          build_and_drop<recycled_vector>(50);
+                      EXPECT_GT(recycling::thread_stats().hits, 0u);
+                      from_thread.push_back(1);
+                      from_thread.push_back(2);
+                  });
+    t.join();
+    // parked here; the exited thread released its own blocks
+    recycling::trim();
+    recycling_stats before = recycling::thread_stats();
+    from_thread = recycled_vector();
+    EXPECT_EQ(1u, (recycling::thread_stats() - before).parked);
+}
+
+TEST(recycling_cache, composes)
+{
+    typedef recycling_vector_policy<pooled_vector_policy> pooled;
+    typedef recycling_vector_policy<vector_stats_policy> counted_recycling;
+
+    build_and_drop<vector<int, pooled> >(10);
+    size_t slabs = block_pool::thread_slab_count();
+    for (int round = 0; round != 100; ++round)
+        build_and_drop<vector<int, pooled> >(10);
+    EXPECT_EQ(slabs, block_pool::thread_slab_count());
+    EXPECT_GT(pooled::thread_stats().hits, 0u);
+
+    vector_stats before = vector_stats::thread_snapshot();
+    build_and_drop<vector<int, counted_recycling> >(10);
+    EXPECT_EQ(1u, (vector_stats::thread_snapshot() - before).detaches);
+}
+
+TEST(recycling_cache, exception_safety)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   vector<counted, recycling> v;
+                   for (int i = 0; i != 6; ++i)
+                       v.push_back(i);
+                   vector<counted, recycling> copy = v;
+                   copy.insert(copy.begin() + 2, 10);
+                   EXPECT_EQ(7u, copy.size());
+               });
+}
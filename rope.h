@@ -0,0 +1,226 @@
+#ifndef VECTOR_ROPE_H
+#define VECTOR_ROPE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "vector.h"
+
+// Read-only concatenation of vectors that does not copy their elements.
+//
+// Each piece is kept as a leaf, a copy of the vector that shares its block,
+// so appending costs a reference count increment however long the piece is.
+// The leaves are laid out in order next to the running totals of their
+// sizes: operator[] finds its leaf by binary search, O(log leaves), and the
+// iterators walk one leaf after another. flatten() makes a plain vector with
+// a single allocation.
+//
+// The pieces stay shared: writing to, erasing from or popping the vector a
+// leaf came from detaches that vector, as with any copy, and leaves the rope
+// unchanged.
+template<typename T>
+class rope {
+public:
+    typedef T value_type;
+    typedef T const &const_reference;
+
+    class const_iterator {
+    public:
+        typedef T value_type;
+        typedef T const &reference;
+        typedef T const *pointer;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::forward_iterator_tag iterator_category;
+
+        const_iterator() noexcept = default;
+
+        reference operator*() const noexcept {
+            return *pos;
+        }
+
+        pointer operator->() const noexcept {
+            return pos;
+        }
+
+        const_iterator &operator++() noexcept {
+            if (++pos == last) {
+                enter(leaf + 1);
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) noexcept {
+            const_iterator result(*this);
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const_iterator const &other) const noexcept {
+            return pos == other.pos;
+        }
+
+        bool operator!=(const_iterator const &other) const noexcept {
+            return pos != other.pos;
+        }
+
+    private:
+        friend class rope;
+
+        const_iterator(rope const *owner, size_t leaf) noexcept : owner(owner) {
+            enter(leaf);
+        }
+
+        void enter(size_t k) noexcept {
+            leaf = k;
+            if (k == owner->leaves.size()) {
+                pos = last = nullptr;
+                return;
+            }
+            pos = owner->leaves[k].data();
+            last = pos + owner->leaves[k].size();
+        }
+
+        rope const *owner = nullptr;
+        size_t leaf = 0;
+        T const *pos = nullptr;
+        T const *last = nullptr;
+    };
+
+    rope() noexcept = default;
+
+    explicit rope(vector<T> const &piece) {
+        append(piece);
+    }
+
+    // Room for `count` leaves in total, so that appends do not reallocate.
+    void reserve(size_t count) {
+        leaves.reserve(count);
+        ends.reserve(count);
+    }
+
+    rope &append(vector<T> const &piece) {
+        if (!piece.empty()) {
+            ends.reserve(ends.size() + 1);
+            leaves.push_back(piece);
+            ends.push_back(size() + piece.size());
+        }
+        return *this;
+    }
+
+    rope &append(rope const &other) {
+        // other may be *this
+        size_t count = other.leaves.size();
+        size_t offset = size();
+        leaves.reserve(leaves.size() + count);
+        ends.reserve(ends.size() + count);
+        for (size_t k = 0; k != count; ++k) {
+            leaves.push_back(other.leaves[k]);
+            ends.push_back(offset + other.ends[k]);
+        }
+        return *this;
+    }
+
+    rope &operator+=(vector<T> const &piece) {
+        return append(piece);
+    }
+
+    rope &operator+=(rope const &other) {
+        return append(other);
+    }
+
+    size_t size() const noexcept {
+        return ends.empty() ? 0 : ends.back();
+    }
+
+    bool empty() const noexcept {
+        return ends.empty();
+    }
+
+    const_reference operator[](size_t i) const noexcept {
+        size_t k = static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), i) - ends.begin());
+        assert(k != leaves.size());
+        return leaves[k].data()[k == 0 ? i : i - ends[k - 1]];
+    }
+
+    // The leaves in order; none of them is empty.
+    size_t leaf_count() const noexcept {
+        return leaves.size();
+    }
+
+    vector<T> const &leaf(size_t k) const noexcept {
+        return leaves[k];
+    }
+
+    // Calls f(data, size) for each leaf in order.
+    template<typename F>
+    void for_each_chunk(F f) const {
+        for (auto const &piece : leaves) {
+            f(piece.data(), piece.size());
+        }
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(this, leaves.size());
+    }
+
+    // A single leaf is returned as is, still sharing its block.
+    vector<T> flatten() const {
+        if (leaves.size() == 1) {
+            return leaves[0];
+        }
+        vector<T> result;
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            result.overwrite(size(), [this](T *out) {
+                for (auto const &piece : leaves) {
+                    std::memcpy(static_cast<void *>(out), piece.data(), piece.size() * sizeof(T));
+                    out += piece.size();
+                }
+            });
+        } else {
+            result.reserve(size());
+            for (auto const &piece : leaves) {
+                for (T const *p = piece.data(), *last = p + piece.size(); p != last; ++p) {
+                    result.push_back(*p);
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    std::vector<vector<T>> leaves;
+    // ends[k] is the total size of leaves 0..k
+    std::vector<size_t> ends;
+};
+
+template<typename T>
+rope<T> operator+(rope<T> a, vector<T> const &b) {
+    return std::move(a.append(b));
+}
+
+template<typename T>
+rope<T> operator+(rope<T> a, rope<T> const &b) {
+    return std::move(a.append(b));
+}
+
+// concat(a, b, c) is rope<T>(a) + b + c.
+template<typename T, typename... Pieces>
+rope<T> concat(vector<T> const &first, Pieces const &... rest) {
+    rope<T> result;
+    result.reserve(1 + sizeof...(rest));
+    result.append(first);
+    (result.append(rest), ...);
+    return result;
+}
+
+#endif //VECTOR_ROPE_H
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "gtest/gtest.h"
+#include "rope.h"
+
+namespace
+{
+    vector<int> range(int first, int last)
+    {
+        vector<int> v;
+        for (int i = first; i != last; ++i)
+            v.push_back(i);
+        return v;
+    }
+}
+
+TEST(rope, indexes_across_leaves)
+{
+    vector<int> a = range(0, 100);
+    vector<int> b = range(100, 101);
+    vector<int> empty;
+    vector<int> c = range(101, 1000);
+    rope<int> r = concat(a, b, empty, c);
+
+    ASSERT_EQ(1000u, r.size());
+    EXPECT_EQ(3u, r.leaf_count());
+    for (size_t i = 0; i != r.size(); ++i)
+        EXPECT_EQ(static_cast<int>(i), r[i]);
+}
+
+TEST(rope, shares_leaf_buffers)
+{
+    vector<int> a = range(0, 1000);
+    vector<int> b = range(1000, 3000);
+    rope<int> r;
+    r.append(a);
+
+    alloc_stats_scope s;
+    r += b;
+    // only the leaf table grows; no element is copied
+    EXPECT_LE(s.stats().allocations, 2u);
+    EXPECT_EQ(std::as_const(a).data(), r.leaf(0).data());
+    EXPECT_EQ(std::as_const(b).data(), r.leaf(1).data());
+
+    a[0] = -1;
+    EXPECT_EQ(0, r[0]);
+}
+
+TEST(rope, shrinking_a_piece_leaves_the_rope_unchanged)
+{
+    vector<int> a = range(0, 100);
+    vector<int> b = range(100, 200);
+    vector<int> c = range(200, 300);
+    vector<int> d = range(300, 400);
+    rope<int> r = concat(a, b, c, d);
+
+    a.pop_back();
+    b.erase(b.begin() + 10, b.end());
+    c.resize(1, 0);
+    d.clear();
+    EXPECT_EQ(99u, a.size());
+    EXPECT_EQ(10u, b.size());
+    EXPECT_EQ(1u, c.size());
+    EXPECT_TRUE(d.empty());
+
+    ASSERT_EQ(400u, r.size());
+    for (size_t i = 0; i != r.size(); ++i)
+        EXPECT_EQ(static_cast<int>(i), r[i]);
+}
+
+TEST(rope, iterates_chunk_by_chunk)
+{
+    rope<int> r = concat(range(0, 10), range(10, 11), range(11, 50));
+    std::vector<int> seen(r.begin(), r.end());
+    ASSERT_EQ(50u, seen.size());
+    for (int i = 0; i != 50; ++i)
+        EXPECT_EQ(i, seen[i]);
+
+    size_t chunks = 0;
+    size_t total = 0;
+    r.for_each_chunk([&](int const* data, size_t n)
+                     {
+                         EXPECT_EQ(static_cast<int>(total), data[0]);
+                         total += n;
+                         ++chunks;
+                     });
+    EXPECT_EQ(3u, chunks);
+    EXPECT_EQ(50u, total);
+
+    rope<int> empty;
+    EXPECT_TRUE(empty.begin() == empty.end());
+}
+
+TEST(rope, concatenates_ropes)
+{
+    rope<int> r = concat(range(0, 5), range(5, 10));
+    r = r + r;
+    r.append(r);
+    ASSERT_EQ(40u, r.size());
+    for (size_t i = 0; i != r.size(); ++i)
+        EXPECT_EQ(static_cast<int>(i % 10), r[i]);
+}
+
+TEST(rope, flatten_allocates_once)
+{
+    rope<int> r = concat(range(0, 300), range(300, 301), range(301, 1000));
+    alloc_stats_scope s;
+    vector<int> flat = r.flatten();
+    EXPECT_EQ(1u, s.stats().allocations);
+    ASSERT_EQ(1000u, flat.size());
+    for (int i = 0; i != 1000; ++i)
+        EXPECT_EQ(i, flat[i]);
+
+    vector<int> single = range(0, 10);
+    vector<int> const same = rope<int>(single).flatten();
+    EXPECT_EQ(std::as_const(single).data(), same.data());
+    EXPECT_TRUE(rope<int>().flatten().empty());
+}
+
+TEST(rope, flatten_non_trivial)
+{
+    vector<std::string> a;
+    vector<std::string> b;
+    for (int i = 0; i != 20; ++i)
+        (i < 7 ? a : b).push_back(std::to_string(i));
+    vector<std::string> flat = concat(a, b).flatten();
+    ASSERT_EQ(20u, flat.size());
+    for (int i = 0; i != 20; ++i)
+        EXPECT_EQ(std::to_string(i), flat[i]);
+}
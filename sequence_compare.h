@@ -0,0 +1,38 @@
+#ifndef VECTOR_SEQUENCE_COMPARE_H
+#define VECTOR_SEQUENCE_COMPARE_H
+
+#include <algorithm>
+
+// Comparison operators of a sequence container, from its size(), begin()
+// and end(), with the meaning they have for the standard containers: equal
+// sizes and elements, and lexicographical order. A container gets them by
+// deriving from sequence_compare of itself; they are found by argument
+// dependent lookup only.
+template<typename Derived>
+struct sequence_compare {
+    friend bool operator==(Derived const &a, Derived const &b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    friend bool operator!=(Derived const &a, Derived const &b) {
+        return !(a == b);
+    }
+
+    friend bool operator<(Derived const &a, Derived const &b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+    }
+
+    friend bool operator<=(Derived const &a, Derived const &b) {
+        return !(b < a);
+    }
+
+    friend bool operator>(Derived const &a, Derived const &b) {
+        return b < a;
+    }
+
+    friend bool operator>=(Derived const &a, Derived const &b) {
+        return !(a < b);
+    }
+};
+
+#endif //VECTOR_SEQUENCE_COMPARE_H
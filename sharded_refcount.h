@@ -0,0 +1,85 @@
+#ifndef VECTOR_SHARDED_REFCOUNT_H
+#define VECTOR_SHARDED_REFCOUNT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "epoch_domain.h"
+
+// Reference count for objects that many threads copy and drop at once.
+//
+// The count starts with one owner reference. While the owner holds it, every
+// other acquire and release only touches the calling thread's shard, each on
+// a cache line of its own, so hot copies do not bounce a shared line. The
+// shards may go negative when a reference is dropped on another thread than
+// the one that took it; only their sum is meaningful.
+//
+// release_owner() switches the count to a single central word: it waits
+// out an epoch_domain grace period so no thread is still updating a shard,
+// folds the shards into the central word and drops the owner reference.
+// From then on the last release() is reported as such.
+//
+// acquire() requires the caller to hold a reference already, or to have
+// found the object inside the same epoch guard that the owner synchronizes
+// with before releasing it.
+class sharded_refcount {
+public:
+    sharded_refcount() noexcept = default;
+
+    sharded_refcount(sharded_refcount const &) = delete;
+
+    sharded_refcount &operator=(sharded_refcount const &) = delete;
+
+    void acquire(epoch_domain::guard const &g) noexcept {
+        if (sharded.load()) {
+            shards[g.slot()].count.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            central.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void acquire(epoch_domain &domain = epoch_domain::global()) noexcept {
+        epoch_domain::guard g(domain);
+        acquire(g);
+    }
+
+    // Returns true when this dropped the last reference.
+    bool release(epoch_domain &domain = epoch_domain::global()) noexcept {
+        epoch_domain::guard g(domain);
+        if (sharded.load()) {
+            shards[g.slot()].count.fetch_sub(1, std::memory_order_release);
+            return false;
+        }
+        return central.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    // Drops the owner reference; returns true when it was the last one.
+    // Must be called once, by the owner.
+    bool release_owner(epoch_domain &domain = epoch_domain::global()) {
+        // until the shards are folded in, central undercounts: the bias
+        // keeps releases of sharded references from reaching zero early
+        central.fetch_add(bias, std::memory_order_relaxed);
+        sharded.store(false);
+        domain.synchronize();
+        std::ptrdiff_t sum = 0;
+        for (auto &shard : shards) {
+            sum += shard.count.exchange(0, std::memory_order_acq_rel);
+        }
+        std::ptrdiff_t delta = sum - 1 - bias;
+        return central.fetch_add(delta, std::memory_order_acq_rel) + delta == 0;
+    }
+
+private:
+    static constexpr std::ptrdiff_t bias = PTRDIFF_MAX / 2;
+
+    struct alignas(64) shard {
+        std::atomic<std::ptrdiff_t> count{0};
+    };
+
+    std::atomic<bool> sharded{true};
+    alignas(64) std::atomic<std::ptrdiff_t> central{1};
+    shard shards[epoch_domain::slot_count];
+};
+
+#endif //VECTOR_SHARDED_REFCOUNT_H
@@ -0,0 +1,57 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "sharded_refcount.h"
+
+TEST(sharded_refcount, owner_alone)
+{
+    sharded_refcount r;
+    EXPECT_TRUE(r.release_owner());
+}
+
+TEST(sharded_refcount, last_release_after_owner)
+{
+    sharded_refcount r;
+    r.acquire();
+    r.acquire();
+    EXPECT_FALSE(r.release_owner());
+    EXPECT_FALSE(r.release());
+    EXPECT_TRUE(r.release());
+}
+
+TEST(sharded_refcount, exactly_one_last_release)
+{
+    const int threads = 8;
+    const int per_thread = 10000;
+    sharded_refcount r;
+
+    // references are taken on one set of threads and dropped on another,
+    // racing with the owner's release
+    std::vector<std::thread> takers;
+    for (int t = 0; t != threads; ++t)
+        takers.emplace_back([&r]
+                            {
+                                for (int i = 0; i != per_thread; ++i)
+                                    r.acquire();
+                            });
+    for (auto& t : takers)
+        t.join();
+
+    std::atomic<int> last_releases(0);
+    std::vector<std::thread> droppers;
+    for (int t = 0; t != threads; ++t)
+        droppers.emplace_back([&r, &last_releases]
+                              {
+                                  for (int i = 0; i != per_thread; ++i)
+                                      if (r.release())
+                                          ++last_releases;
+                              });
+    if (r.release_owner())
+        ++last_releases;
+    for (auto& t : droppers)
+        t.join();
+
+    EXPECT_EQ(1, last_releases.load());
+}
@@ -8,6 +8,59 @@
 #include <variant>
 #include <memory>
 #include <cassert>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "sequence_compare.h"
+
+// Compile-time hooks into the life of vector's heap blocks. A policy is a
+// class with the static members below; vector<T, Policy> calls them at every
+// event, so derive from default_vector_policy and shadow the ones of
+// interest. Sizes are in bytes of elements, block headers excluded, except
+// for the allocation hooks. The default's event hooks are empty inline
+// functions and cost nothing, and its allocation hooks are operator new and
+// delete.
+struct default_vector_policy {
+    // A copy of the vector now shares its heap block of `capacity` bytes.
+    static void on_share(size_t capacity) noexcept {}
+
+    // A write to a shared block copied `copied` bytes into a private block.
+    static void on_detach(size_t capacity, size_t copied) noexcept {}
+
+    // The elements moved to a new block with a different capacity.
+    static void on_reallocate(size_t old_capacity, size_t new_capacity, size_t copied) noexcept {}
+
+    // push_back or insert ran out of capacity; follows on_reallocate or
+    // on_inline_to_heap.
+    static void on_grow(size_t old_capacity, size_t new_capacity) noexcept {}
+
+    // The single inline element moved to a heap block.
+    static void on_inline_to_heap(size_t capacity) noexcept {}
+
+    // The last reference to a heap block was dropped.
+    static void on_free(size_t capacity) noexcept {}
+
+    // Storage for every heap block, of `size` bytes including the header.
+    // deallocate_block receives the size the block was allocated with.
+    static void *allocate_block(size_t size) {
+        return operator new(size);
+    }
+
+    static void deallocate_block(void *block, size_t size) noexcept {
+        operator delete(block);
+    }
+
+    // The last reference to a block holding `size` bytes of elements was
+    // dropped, after on_free. release(block) destroys the elements and
+    // deallocates the block; it must be called once, on any thread.
+    static void release_block(void *block, size_t size, void (*release)(void *) noexcept) noexcept {
+        release(block);
+    }
+};
+
+template<typename T, size_t N>
+class inplace_vector;
 
 template<typename T>
 struct iterator {
@@ -17,95 +70,98 @@ struct iterator {
     typedef T *pointer;
     typedef std::random_access_iterator_tag iterator_category;
 
-    template<typename> friend
+    template<typename, typename> friend
     class vector;
 
+    template<typename, size_t> friend
+    class inplace_vector;
+
     template<typename> friend
     struct const_iterator;
 
-    iterator &operator++() {
+    constexpr iterator &operator++() {
         ++ptr;
         return *this;
     }
 
-    const iterator operator++(int) {
+    constexpr const iterator operator++(int) {
         iterator result(*this);
         ++*this;
         return result;
     }
 
-    iterator &operator--() {
+    constexpr iterator &operator--() {
         --ptr;
         return *this;
     }
 
-    const iterator operator--(int) {
+    constexpr const iterator operator--(int) {
         iterator result(*this);
         --*this;
         return result;
     }
 
-    reference operator*() const {
+    constexpr reference operator*() const {
         return *ptr;
     }
 
-    pointer operator->() const {
+    constexpr pointer operator->() const {
         return ptr;
     }
 
-    bool operator==(iterator const &other) const {
+    constexpr bool operator==(iterator const &other) const {
         return ptr == other.ptr;
     }
 
-    bool operator!=(iterator const &other) const {
+    constexpr bool operator!=(iterator const &other) const {
         return ptr != other.ptr;
     }
 
-    bool operator<(iterator const &other) {
+    constexpr bool operator<(iterator const &other) {
         return ptr < other.ptr;
     }
 
-    bool operator>(iterator const &other) {
+    constexpr bool operator>(iterator const &other) {
         return ptr > other.ptr;
     }
 
-    bool operator<=(iterator const &other) {
+    constexpr bool operator<=(iterator const &other) {
         return ptr <= other.ptr;
     }
 
-    bool operator>=(iterator const &other) {
+    constexpr bool operator>=(iterator const &other) {
         return ptr >= other.ptr;
     }
 
-    iterator &operator+=(size_t n) {
+    constexpr iterator &operator+=(size_t n) {
         ptr += n;
         return *this;
     }
 
-    iterator &operator-=(size_t n) {
+    constexpr iterator &operator-=(size_t n) {
         ptr -= n;
         return *this;
     }
 
-    reference operator[](size_t n) {
+    constexpr reference operator[](size_t n) {
         return ptr[n];
     }
 
-    friend difference_type operator-(iterator const &p, iterator const &q) {
+    friend constexpr difference_type operator-(iterator const &p, iterator const &q) {
         return p.ptr - q.ptr;
     }
 
-    friend iterator operator+(iterator p, size_t n) {
+    friend constexpr iterator operator+(iterator p, size_t n) {
         p += n;
         return p;
     }
 
-    friend iterator operator-(iterator p, size_t n) {
+    friend constexpr iterator operator-(iterator p, size_t n) {
         p -= n;
         return p;
     }
 
-    friend iterator operator+(size_t n, iterator const &p) {
+    friend constexpr iterator operator+(size_t n, iterator const &p) {
         p += n;
         return p;
     }
@@ -113,7 +169,7 @@ struct iterator {
     pointer ptr = nullptr;
 
 private:
-    explicit iterator(pointer p) : ptr(p) {}
+    explicit constexpr iterator(pointer p) : ptr(p) {}
 };
 
 template<typename T>
@@ -124,107 +180,110 @@ struct const_iterator {
     typedef T *pointer;
     typedef std::random_access_iterator_tag iterator_category;
 
-    template<typename> friend
+    template<typename, typename> friend
     class vector;
 
-    const_iterator(iterator<T> const &other) : ptr(other.ptr) {}
+    template<typename, size_t> friend
+    class inplace_vector;
 
-    const_iterator &operator++() {
+    constexpr const_iterator(iterator<T> const &other) : ptr(other.ptr) {}
+
+    constexpr const_iterator &operator++() {
         ++ptr;
         return *this;
     }
 
-    const const_iterator operator++(int) {
+    constexpr const const_iterator operator++(int) {
         const_iterator result(*this);
         ++*this;
         return result;
     }
 
-    const_iterator &operator--() {
+    constexpr const_iterator &operator--() {
         --ptr;
         return *this;
     }
 
-    const const_iterator operator--(int) {
+    constexpr const const_iterator operator--(int) {
         const_iterator result(*this);
         --*this;
         return result;
     }
 
-    reference operator*() const {
+    constexpr reference operator*() const {
         return *ptr;
     }
 
-    pointer operator->() const {
+    constexpr pointer operator->() const {
         return ptr;
     }
 
-    bool operator==(const_iterator const &other) const {
+    constexpr bool operator==(const_iterator const &other) const {
         return ptr == other.ptr;
     }
 
-    bool operator!=(const_iterator const &other) const {
+    constexpr bool operator!=(const_iterator const &other) const {
         return ptr != other.ptr;
     }
 
-    bool operator<(const_iterator const &other) {
+    constexpr bool operator<(const_iterator const &other) {
         return ptr < other.ptr;
     }
 
-    bool operator>(const_iterator const &other) {
+    constexpr bool operator>(const_iterator const &other) {
         return ptr > other.ptr;
     }
 
-    bool operator<=(const_iterator const &other) {
+    constexpr bool operator<=(const_iterator const &other) {
         return ptr <= other.ptr;
     }
 
-    bool operator>=(const_iterator const &other) {
+    constexpr bool operator>=(const_iterator const &other) {
         return ptr >= other.ptr;
     }
 
-    const_iterator &operator+=(size_t n) {
+    constexpr const_iterator &operator+=(size_t n) {
         ptr += n;
         return *this;
     }
 
-    const_iterator &operator-=(size_t n) {
+    constexpr const_iterator &operator-=(size_t n) {
         ptr -= n;
         return *this;
     }
 
-    reference operator[](size_t n) {
+    constexpr reference operator[](size_t n) {
         return ptr[n];
     }
 
-    friend difference_type operator-(const_iterator const &p,
-                                     const_iterator const &q) {
+    friend constexpr difference_type operator-(const_iterator const &p,
+                                               const_iterator const &q) {
         return p.ptr - q.ptr;
     }
 
-    friend const_iterator operator+(const_iterator p, size_t n) {
+    friend constexpr const_iterator operator+(const_iterator p, size_t n) {
         p += n;
         return p;
     }
 
-    friend const_iterator operator-(const_iterator p, size_t n) {
+    friend constexpr const_iterator operator-(const_iterator p, size_t n) {
         p -= n;
         return p;
     }
 
-    friend const_iterator operator+(size_t n, const_iterator const &p) {
+    friend constexpr const_iterator operator+(size_t n, const_iterator const &p) {
         p += n;
         return p;
     }
 
 private:
-    explicit const_iterator(pointer p) : ptr(p) {}
+    explicit constexpr const_iterator(pointer p) : ptr(p) {}
 
     pointer ptr = nullptr;
 };
 
-template<typename T>
-class vector {
+template<typename T, typename Policy = default_vector_policy>
+class vector : public sequence_compare<vector<T, Policy>> {
 public:
     typedef T value_type;
     typedef T *pointer;
@@ -256,6 +315,7 @@ public:
         variant = other.variant;
         if (is_ptr_type() && std::get<0>(variant)) {
             counter_in_ptr(std::get<0>(variant))++;
+            Policy::on_share(bytes(capacity_in_ptr(std::get<0>(variant))));
         }
     }
 
@@ -288,11 +348,54 @@ public:
         variant = other.variant;
         if (is_ptr_type() && std::get<0>(variant)) {
             counter_in_ptr(std::get<0>(variant))++;
+            Policy::on_share(bytes(capacity_in_ptr(std::get<0>(variant))));
         }
         return *this;
     }
 
 
+    // Construction and assignment from a lazy expression of vector_expr.h,
+    // evaluated in a single pass by overwrite().
+    template<typename Expr, typename = typename Expr::vector_expression>
+    vector(Expr const &e) {
+        *this = e;
+    }
+
+    template<typename Expr, typename = typename Expr::vector_expression>
+    vector &operator=(Expr const &e) {
+        overwrite(e.size(), [&e](pointer out) { e.evaluate(out); });
+        return *this;
+    }
+
+    // Replaces the contents with `n` elements written by fill(out), which must
+    // store all of them and must not throw. The current buffer is reused when
+    // it is unshared and large enough, so fill may read from it elementwise.
+    template<typename Fill>
+    void overwrite(size_t n, Fill const &fill) {
+        static_assert(std::is_trivially_copyable<value_type>::value,
+                      "overwrite() stores over elements without destroying them");
+        if (n == 0) {
+            clear();
+            return;
+        }
+        if (!is_ptr_type() && n == 1) {
+            fill(&std::get<1>(variant));
+            return;
+        }
+        if (is_ptr_type() && std::get<0>(variant) && counter_in_ptr(std::get<0>(variant)) == 1 &&
+            capacity_in_ptr(std::get<0>(variant)) >= n) {
+            fill(get_data(std::get<0>(variant)));
+            size_in_ptr(std::get<0>(variant)) = n;
+            return;
+        }
+        auto ptr = allocate(n);
+        set_size(ptr, n);
+        set_capacity(ptr, n);
+        set_counter(ptr, 1);
+        fill(get_data(ptr));
+        replace_block(ptr);
+    }
+
     template<typename InputIterator>
     void assign(InputIterator first, InputIterator last) {
         if (is_ptr_type()) {
@@ -322,10 +425,7 @@ public:
     }
 
     reference front() {
-        if (is_ptr_type()) {
-            return get_data(std::get<0>(variant))[0];
-        }
-        return std::get<1>(variant);
+        return data()[0];
     }
 
     const_reference front() const {
@@ -336,10 +436,7 @@ public:
     }
 
     reference back() {
-        if (is_ptr_type()) {
-            return get_data(std::get<0>(variant))[size_in_ptr(std::get<0>(variant)) - 1];
-        }
-        return std::get<1>(variant);
+        return data()[size() - 1];
     }
 
     const_reference back() const {
@@ -373,9 +470,39 @@ public:
         size_in_ptr(std::get<0>(variant))++;
     };
 
+    // push_back that never allocates: returns false, leaving the vector
+    // unchanged, when the element does not fit in an unshared block. After
+    // reserve_exact(n), the first n - size() calls succeed.
+    bool try_push_back(const_reference a) {
+        if (!is_ptr_type()) {
+            return false;
+        }
+        auto ptr = std::get<0>(variant);
+        if (ptr == nullptr) {
+            try {
+                variant = a;
+            } catch (...) {
+                variant = nullptr;
+                throw;
+            }
+            return true;
+        }
+        if (counter_in_ptr(ptr) > 1 || size_in_ptr(ptr) == capacity_in_ptr(ptr)) {
+            return false;
+        }
+        construct(get_data(ptr) + size_in_ptr(ptr), a);
+        size_in_ptr(ptr)++;
+        return true;
+    }
+
+    // A shared block is left to the other vectors: this one detaches with a
+    // copy of all but the last element.
     void pop_back() {
         if (!is_ptr_type() && size() == 1) {
             variant = nullptr;
+        } else if (counter_in_ptr(std::get<0>(variant)) > 1) {
+            size_t sz = size() - 1;
+            replace_block(copy_to_new_block(capacity(), sz), sz);
         } else {
             std::destroy(get_data(std::get<0>(variant)) + size_in_ptr(std::get<0>(variant)) - 1,
                          get_data(std::get<0>(variant)) + size_in_ptr(std::get<0>(variant)));
@@ -383,18 +510,20 @@ public:
         }
     }
 
+    // Mutable access detaches a shared buffer, like operator[].
     pointer data() {
         if (is_ptr_type()) {
+            if (!std::get<0>(variant)) {
+                return nullptr;
+            }
+            copy_if_necessary(std::get<0>(variant));
             return get_data(std::get<0>(variant));
         }
         return &std::get<1>(variant);
     }
 
     const_pointer data() const {
-        if (is_ptr_type()) {
-            return get_data_const(std::get<0>(variant));
-        }
-        return &std::get<1>(variant);
+        return get_data();
     }
 
     iterator begin() {
@@ -439,9 +568,8 @@ public:
     }
 
     void convert() {
-        auto new_ptr = reinterpret_cast<info_pointer>(operator new(3 * sizeof(size_t) + sizeof(value_type)));
+        auto new_ptr = allocate(1);
         size_in_ptr(new_ptr) = 1;
-        capacity_in_ptr(new_ptr) = 1;
         counter_in_ptr(new_ptr) = 1;
         try {
             construct(get_data(new_ptr), std::get<1>(variant));
@@ -450,17 +578,29 @@ public:
             throw;
         }
         variant = new_ptr;
+        Policy::on_inline_to_heap(bytes(1));
     }
 
     void reserve(size_t cap) {
         if (cap > capacity()) {
-            if (!is_ptr_type()) {
-                convert();
+            replace_block(copy_to_new_block(cap, size()), size());
+        }
+    }
+
+    // Ensures room for `cap` elements in a block no other vector shares,
+    // allocating one of exactly max(cap, size()) elements if the current
+    // buffer does not qualify. An empty vector needs no block for one
+    // element, which is stored inline.
+    void reserve_exact(size_t cap) {
+        if (is_ptr_type()) {
+            auto ptr = std::get<0>(variant);
+            if (ptr == nullptr ? cap <= 1 : counter_in_ptr(ptr) == 1 && capacity_in_ptr(ptr) >= cap) {
+                return;
             }
-            auto ptr = allocate_and_copy(cap, std::get<0>(variant));
-            free_check(std::get<0>(variant));
-            variant = ptr;
+        } else if (cap <= 1) {
+            return;
         }
+        replace_block(copy_to_new_block(std::max(cap, size()), size()), size());
     }
 
     size_t capacity() const noexcept {
@@ -468,28 +608,44 @@ public:
     }
 
     void resize(size_t sz, value_type val) {
-        if (!is_ptr_type()) {
-            convert();
+        size_t old_size = size();
+        if (sz == old_size) {
+            return;
         }
-        if (sz <= size()) {
-            std::destroy(get_data(std::get<0>(variant)) + sz, get_data(std::get<0>(variant)) + size());
-            size_in_ptr(std::get<0>(variant)) = sz;
+        if (!is_ptr_type() && sz == 0) {
+            variant = nullptr;
+            return;
+        }
+        if (!is_ptr_type() || sz > capacity() || counter_in_ptr(std::get<0>(variant)) > 1) {
+            auto ptr = copy_to_new_block(std::max(sz, capacity()), std::min(sz, old_size));
+            try {
+                for (auto it = get_data(ptr) + size_in_ptr(ptr); it != get_data(ptr) + sz; it++) {
+                    construct(it, val);
+                    size_in_ptr(ptr)++;
+                }
+            } catch (...) {
+                free_always(ptr);
+                throw;
+            }
+            replace_block(ptr, std::min(sz, old_size));
+            return;
+        }
+        auto ptr = std::get<0>(variant);
+        if (sz < old_size) {
+            std::destroy(get_data(ptr) + sz, get_data(ptr) + old_size);
+            size_in_ptr(ptr) = sz;
             return;
         }
-        auto ptr = allocate_and_copy(sz, std::get<0>(variant));
         try {
-            for (auto it = get_data(ptr) + size(); it != get_data(ptr) + sz; it++) {
+            for (auto it = get_data(ptr) + old_size; it != get_data(ptr) + sz; it++) {
                 construct(it, val);
                 size_in_ptr(ptr)++;
             }
         } catch (...) {
-            if (counter_in_ptr(ptr) != 1) {
-                free_always(ptr);
-            }
+            std::destroy(get_data(ptr) + old_size, get_data(ptr) + size_in_ptr(ptr));
+            size_in_ptr(ptr) = old_size;
             throw;
         }
-        free_check(std::get<0>(variant));
-        variant = ptr;
     }
 
     void clear() {
@@ -500,41 +656,24 @@ public:
     }
 
     void insert(const_iterator pos, T const &val) {
-        if (pos == end()) {
-            try {
-                push_back(val);
-            } catch (...) {
-                clear();
-                throw;
-            }
+        auto index = static_cast<size_t>(pos.ptr - get_data());
+        if (index == size()) {
+            push_back(val);
             return;
         }
-        if (is_ptr_type()) {
-            vector buffer;
-            try {
-                for (size_t i = 0u; i < static_cast<size_t>(pos - begin()); i++) {
-                    buffer.push_back(get_data(std::get<0>(variant))[i]);
-                }
-                buffer.push_back(val);
-                for (size_t i = static_cast<size_t>(pos - begin()); i < size(); i++) {
-                    buffer.push_back(get_data(std::get<0>(variant))[i]);
-                }
-            } catch (...) {
-                buffer.clear();
-                throw;
-            }
-            *this = buffer;
+        if (!is_ptr_type() || counter_in_ptr(std::get<0>(variant)) > 1 || size() == capacity()) {
+            insert_to_new_block(index, val);
             return;
         }
-        vector buffer;
-        try {
-            buffer.push_back(*begin());
-            buffer.push_back(val);
-        } catch (...) {
-            buffer.clear();
-            throw;
+        auto ptr = std::get<0>(variant);
+        pointer first = get_data(ptr);
+        pointer last = first + size_in_ptr(ptr);
+        if (std::less<const_pointer>()(&val, first) || !std::less<const_pointer>()(&val, last)) {
+            shift_and_assign(index, val);
+        } else {
+            value_type copy(val);
+            shift_and_assign(index, copy);
         }
-        swap(buffer);
     }
 
     iterator erase(const_iterator pos) {
@@ -546,18 +685,17 @@ public:
             return iterator(first.ptr);
         }
         if (is_ptr_type()) {
-            copy_if_necessary(std::get<0>(variant));
-            if (last == end()) {
-                std::destroy(first.ptr, last.ptr);
-                auto delta = static_cast<size_t>(last - first);
-                size_in_ptr(std::get<0>(variant)) -= delta;
-                return end();
-            }
-            size_t begin_size = first - begin();
+            // positions may point into a block shared with other vectors
+            auto begin_size = static_cast<size_t>(first.ptr - get_data());
             auto erase_size = static_cast<size_t>(last - first);
-            auto end_size = static_cast<size_t>(end() - last);
+            auto end_size = size() - begin_size - erase_size;
             pointer erase_ptr = data() + begin_size;
-            pointer end_ptr = data() + begin_size + erase_size;
+            pointer end_ptr = erase_ptr + erase_size;
+            if (end_size == 0) {
+                std::destroy(erase_ptr, end_ptr);
+                size_in_ptr(std::get<0>(variant)) -= erase_size;
+                return end();
+            }
             if (end_size <= erase_size) {
                 std::destroy(erase_ptr, erase_ptr + erase_size);
                 try {
@@ -659,7 +797,7 @@ private:
         if (!is_ptr_type()) {
             return empty() ? nullptr : const_cast<pointer>(&std::get<1>(variant));
         } else {
-            return data(std::get<0>(variant));
+            return std::get<0>(variant) ? data(std::get<0>(variant)) : nullptr;
         }
     }
 
@@ -719,6 +857,8 @@ private:
                 throw;
             }
             variant = ptr;
+            Policy::on_inline_to_heap(bytes(2));
+            Policy::on_grow(bytes(1), bytes(2));
             return;
         }
         info_pointer ptr = nullptr;
@@ -729,24 +869,108 @@ private:
             free_always(ptr);
             throw;
         }
+        Policy::on_reallocate(bytes(capacity()), bytes(capacity() * 2), bytes(size()));
+        Policy::on_grow(bytes(capacity()), bytes(capacity() * 2));
         free_check(std::get<0>(variant));
         variant = ptr;
     }
 
+    // Copies the first `count` elements of the current buffer (inline value
+    // or heap block) into a new unshared block of capacity `cap`.
+    info_pointer copy_to_new_block(size_t cap, size_t count) {
+        auto new_ptr = allocate(cap);
+        set_size(new_ptr, 0);
+        set_capacity(new_ptr, cap);
+        set_counter(new_ptr, 1);
+        try {
+            std::uninitialized_copy(get_data(), get_data() + count, get_data(new_ptr));
+        } catch (...) {
+            free_empty(new_ptr);
+            throw;
+        }
+        set_size(new_ptr, count);
+        return new_ptr;
+    }
+
+    // Replaces the buffer with a block made by copy_to_new_block, into which
+    // `copied` elements of the old one went.
+    void replace_block(info_pointer ptr, size_t copied) {
+        if (!is_ptr_type()) {
+            Policy::on_inline_to_heap(bytes(capacity_in_ptr(ptr)));
+        } else if (std::get<0>(variant) != nullptr) {
+            if (counter_in_ptr(std::get<0>(variant)) > 1) {
+                Policy::on_detach(bytes(capacity_in_ptr(ptr)), bytes(copied));
+            } else {
+                Policy::on_reallocate(bytes(capacity()), bytes(capacity_in_ptr(ptr)), bytes(copied));
+            }
+        }
+        replace_block(ptr);
+    }
+
+    void replace_block(info_pointer ptr) {
+        if (is_ptr_type()) {
+            free_check(std::get<0>(variant));
+        }
+        variant = ptr;
+    }
+
+    void insert_to_new_block(size_t index, const_reference val) {
+        size_t cap = size() == capacity() ? 2 * capacity() : capacity();
+        size_t old_cap = capacity();
+        auto ptr = copy_to_new_block(cap, index);
+        try {
+            construct(get_data(ptr) + index, val);
+            size_in_ptr(ptr)++;
+            std::uninitialized_copy(get_data() + index, get_data() + size(), get_data(ptr) + index + 1);
+        } catch (...) {
+            free_always(ptr);
+            throw;
+        }
+        size_in_ptr(ptr) = size() + 1;
+        replace_block(ptr, size());
+        if (cap != old_cap) {
+            Policy::on_grow(bytes(old_cap), bytes(cap));
+        }
+    }
+
+    // Inserts into an unshared block with spare capacity; `val` must not
+    // alias an element. Only the basic guarantee holds if an assignment throws.
+    void shift_and_assign(size_t index, const_reference val) {
+        auto ptr = std::get<0>(variant);
+        pointer first = get_data(ptr);
+        size_t sz = size_in_ptr(ptr);
+        construct(first + sz, first[sz - 1]);
+        size_in_ptr(ptr)++;
+        std::copy_backward(first + index, first + sz - 1, first + sz);
+        first[index] = val;
+    }
+
     void free_check(info_pointer ptr) {
         if (ptr != nullptr && --counter_in_ptr(ptr) == 0) {
-            std::destroy(get_data(ptr), get_data(ptr) + size_in_ptr(ptr));
-            free_empty(ptr);
+            Policy::on_free(bytes(capacity_in_ptr(ptr)));
+            Policy::release_block(ptr, bytes(size_in_ptr(ptr)), &vector::release);
         }
     }
 
     void free_always(info_pointer ptr) {
-        std::destroy(get_data(ptr), get_data(ptr) + size_in_ptr(ptr));
-        free_empty(ptr);
+        release(ptr);
+    }
+
+    // free_always of a block no vector refers to any more.
+    static void release(void *block) noexcept {
+        auto ptr = static_cast<info_pointer>(block);
+        auto header = reinterpret_cast<size_t *>(ptr);
+        auto first = reinterpret_cast<pointer>(ptr + 3 * sizeof(size_t));
+        std::destroy(first, first + header[0]);
+        Policy::deallocate_block(ptr, block_bytes(header[1]));
     }
 
     void free_empty(info_pointer ptr) {
-        operator delete(static_cast<void *>(ptr));
+        Policy::deallocate_block(ptr, block_bytes(capacity_in_ptr(ptr)));
+    }
+
+    static constexpr size_t bytes(size_t count) noexcept {
+        return count * sizeof(value_type);
     }
 
     void set_size(const info_pointer ptr, size_t sz) {
@@ -776,22 +1000,26 @@ private:
         }
     }
 
+    // A block with its capacity set, which free_empty relies on.
     info_pointer allocate(size_t sz) {
-        return reinterpret_cast<info_pointer>(operator new(3 * sizeof(size_t) + sz * sizeof(value_type)));
+        auto ptr = static_cast<info_pointer>(Policy::allocate_block(block_bytes(sz)));
+        set_capacity(ptr, sz);
+        return ptr;
+    }
+
+    static constexpr size_t block_bytes(size_t capacity) noexcept {
+        return 3 * sizeof(size_t) + capacity * sizeof(value_type);
     }
 
     info_pointer allocate_and_copy(size_t sz, info_pointer ptr) {
-        auto new_ptr = reinterpret_cast<info_pointer>(operator new(3 * sizeof(size_t) + sz * sizeof(value_type)));
+        auto new_ptr = allocate(sz);
         size_in_ptr(new_ptr) = 0;
-        capacity_in_ptr(new_ptr) = sz;
         counter_in_ptr(new_ptr) = 1;
         if (ptr == nullptr) {
             return new_ptr;
         }
         assert(sz >= size_in_ptr(ptr));
         size_in_ptr(new_ptr) = size_in_ptr(ptr);
-        capacity_in_ptr(new_ptr) = sz;
-        counter_in_ptr(new_ptr) = counter_in_ptr(ptr);
         try {
             std::uninitialized_copy(get_data(ptr), get_data(ptr) + size_in_ptr(ptr), get_data(new_ptr));
         } catch (...) {
@@ -803,12 +1031,9 @@ private:
 
     void copy_if_necessary(info_pointer ptr) {
         if (counter_in_ptr(ptr) > 1) {
-            info_pointer new_ptr = nullptr;
+            info_pointer new_ptr = allocate(capacity_in_ptr(ptr));
             try {
-                new_ptr = reinterpret_cast<info_pointer>(operator new(
-                        3 * sizeof(size_t) + capacity_in_ptr(ptr) * sizeof(value_type)));
                 size_in_ptr(new_ptr) = size_in_ptr(ptr);
-                capacity_in_ptr(new_ptr) = capacity_in_ptr(ptr);
                 counter_in_ptr(new_ptr) = 1;
                 std::uninitialized_copy(get_data(ptr), get_data(ptr) + size_in_ptr(ptr), get_data(new_ptr));
             } catch (...) {
@@ -817,45 +1042,16 @@ private:
             }
             counter_in_ptr(ptr)--;
             variant = new_ptr;
+            Policy::on_detach(bytes(capacity_in_ptr(new_ptr)), bytes(size_in_ptr(new_ptr)));
         }
     }
 
 };
 
 
-template<typename T>
-void swap(vector<T> &a, vector<T> &b) {
+template<typename T, typename Policy>
+void swap(vector<T, Policy> &a, vector<T, Policy> &b) {
     a.swap(b);
 }
 
-template<typename T>
-bool operator==(vector<T> const &a, vector<T> const &b) {
-    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
-}
-
-template<typename T>
-bool operator!=(vector<T> const &a, vector<T> const &b) {
-    return !(a == b);
-}
-
-template<typename T>
-bool operator<(vector<T> const &a, vector<T> const &b) {
-    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
-}
-
-template<typename T>
-bool operator<=(vector<T> const &a, vector<T> const &b) {
-    return a < b || a == b;
-}
-
-template<typename T>
-bool operator>(vector<T> const &a, vector<T> const &b) {
-    return b < a;
-}
-
-template<typename T>
-bool operator>=(vector<T> const &a, vector<T> const &b) {
-    return b <= a;
-}
-
 #endif //VECTOR_VECTOR_H
\ No newline at end of file
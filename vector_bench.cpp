@@ -0,0 +1,1081 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "block_pool.h"
+#include "chunked_vector.h"
+#include "deferred_destruction.h"
+#include "incremental_vector.h"
+#include "persistent_vector.h"
+#include "recycling_cache.h"
+#include "rope.h"
+#include "vector.h"
+#include "vector_expr.h"
+#include "vector_parallel.h"
+#include "vector_search.h"
+#include "vector_sort.h"
+#include "versioned_vector.h"
+
+// Microbenchmarks of ::vector against std::vector.
+// Prints one JSON document with ns/op, allocations/op and bytes copied/op
+// for every (benchmark, container, element type) triple, followed by
+// throughput of concurrent readers and snapshot copies for 1 to 64 threads
+// and of the vector_parallel passes for 1 to hardware_concurrency() threads,
+// vector_sort against std::sort over the vector's own iterators, and the
+// vector_search scans for every kernel set against the std algorithms, and
+// a fused vector_expr assignment against materialized temporaries, and rope
+// concatenation of shared pieces against a deep copy, and new versions of a
+// persistent_vector against copy-on-write copies of a vector, and the worst
+// push_back of incremental_vector against vector and std::vector, and
+// small-block churn through block_pool and recycling_cache against malloc,
+// and dropping a large vector of strings with and without deferred
+// destruction.
+//
+// usage: vector_bench [--min-time-ms N] [--filter SUBSTRING] [--sort-sizes N,N,...]
+
+namespace {
+    struct pod64 {
+        std::uint64_t words[8];
+    };
+
+    bool operator==(pod64 const &a, pod64 const &b) {
+        return std::memcmp(a.words, b.words, sizeof(a.words)) == 0;
+    }
+
+    bool operator<(pod64 const &a, pod64 const &b) {
+        return std::memcmp(a.words, b.words, sizeof(a.words)) < 0;
+    }
+
+    static_assert(sizeof(pod64) == 64, "pod64 must be 64 bytes");
+
+    template<typename T>
+    T make_value(size_t i);
+
+    template<>
+    int make_value<int>(size_t i) {
+        return static_cast<int>(i * 2654435761u);
+    }
+
+    template<>
+    pod64 make_value<pod64>(size_t i) {
+        pod64 result{};
+        for (size_t j = 0; j != 8; ++j) {
+            result.words[j] = i * 0x9E3779B97F4A7C15ull + j;
+        }
+        return result;
+    }
+
+    template<>
+    std::string make_value<std::string>(size_t i) {
+        // long enough to defeat the small string optimization
+        return "value-" + std::to_string(i) + "-padding-padding-padding";
+    }
+
+    size_t weight(int v) {
+        return static_cast<size_t>(v);
+    }
+
+    size_t weight(pod64 const &v) {
+        return v.words[0];
+    }
+
+    size_t weight(std::string const &s) {
+        return s.size();
+    }
+
+    template<typename T>
+    char const *type_name();
+
+    template<>
+    char const *type_name<int>() {
+        return "int";
+    }
+
+    template<>
+    char const *type_name<pod64>() {
+        return "pod64";
+    }
+
+    template<>
+    char const *type_name<std::string>() {
+        return "std::string";
+    }
+
+    template<>
+    char const *type_name<std::uint64_t>() {
+        return "uint64_t";
+    }
+
+    template<>
+    char const *type_name<float>() {
+        return "float";
+    }
+
+    // Element wrapper counting every copy and move of the wrapped value inside
+    // an alloc_stats_scope. Used in a separate untimed pass to derive
+    // bytes copied per operation.
+    template<typename T>
+    struct copy_counted {
+        static size_t copies;
+
+        copy_counted(T const &v) : value(v) {}
+
+        copy_counted(copy_counted const &other) : value(other.value) {
+            count();
+        }
+
+        copy_counted(copy_counted &&other) noexcept : value(std::move(other.value)) {
+            count();
+        }
+
+        copy_counted &operator=(copy_counted const &other) {
+            value = other.value;
+            count();
+            return *this;
+        }
+
+        copy_counted &operator=(copy_counted &&other) noexcept {
+            value = std::move(other.value);
+            count();
+            return *this;
+        }
+
+        static void count() {
+            if (alloc_stats::enabled()) {
+                ++copies;
+            }
+        }
+
+        friend bool operator==(copy_counted const &a, copy_counted const &b) {
+            return a.value == b.value;
+        }
+
+        friend bool operator<(copy_counted const &a, copy_counted const &b) {
+            return a.value < b.value;
+        }
+
+        friend size_t weight(copy_counted const &c) {
+            return weight(c.value);
+        }
+
+        T value;
+    };
+
+    template<typename T>
+    size_t copy_counted<T>::copies = 0;
+
+    template<typename T>
+    struct element_traits {
+        typedef T value_type;
+
+        static T make(size_t i) {
+            return make_value<T>(i);
+        }
+
+        static void reset_copies() {}
+
+        static size_t copies() {
+            return 0;
+        }
+    };
+
+    template<typename T>
+    struct element_traits<copy_counted<T>> {
+        typedef T value_type;
+
+        static copy_counted<T> make(size_t i) {
+            return copy_counted<T>(make_value<T>(i));
+        }
+
+        static void reset_copies() {
+            copy_counted<T>::copies = 0;
+        }
+
+        static size_t copies() {
+            return copy_counted<T>::copies;
+        }
+    };
+
+    template<typename T>
+    void do_not_optimize(T const &value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    struct options {
+        std::chrono::nanoseconds min_time = std::chrono::milliseconds(50);
+        std::string filter;
+        std::vector<size_t> sort_sizes = {1000000, 10000000, 100000000};
+    };
+
+    struct result {
+        double ns_per_op;
+        double allocations_per_op;
+        double bytes_copied_per_op;
+        size_t iterations;
+    };
+
+    // Runs `op` over batches of freshly prepared states until `min_time` of
+    // timed work has accumulated, or ten times that much wall time has passed.
+    // Preparation and destruction of the states are neither timed nor
+    // counted. A `reusable` op leaves its state ready for another run, so the
+    // whole batch runs on a single state.
+    template<typename Setup, typename Op>
+    void run_batches(size_t batch, bool reusable, Setup const &setup, Op const &op,
+                     std::chrono::nanoseconds min_time,
+                     std::chrono::nanoseconds &elapsed, size_t &iterations, size_t &allocations) {
+        typedef decltype(setup()) state_type;
+        elapsed = std::chrono::nanoseconds(0);
+        iterations = 0;
+        allocations = 0;
+        auto deadline = std::chrono::steady_clock::now() + 10 * min_time;
+        do {
+            std::vector<state_type> states;
+            states.reserve(reusable ? 1 : batch);
+            for (size_t i = 0; i != (reusable ? 1 : batch); ++i) {
+                states.push_back(setup());
+            }
+            std::chrono::steady_clock::time_point start, finish;
+            {
+                alloc_stats_scope scope;
+                start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i != batch; ++i) {
+                    op(states[reusable ? 0 : i]);
+                }
+                finish = std::chrono::steady_clock::now();
+                allocations += scope.stats().allocations;
+            }
+            elapsed += finish - start;
+            iterations += batch;
+            if (reusable && batch < (size_t(1) << 20)) {
+                batch *= 2;
+            }
+        } while (elapsed < min_time && std::chrono::steady_clock::now() < deadline);
+    }
+
+    template<template<typename> class Container, typename T, typename Setup, typename Op>
+    result measure(options const &opts, size_t ops_per_iteration, bool reusable,
+                   Setup const &setup, Op const &op) {
+        typedef Container<T> plain;
+        typedef Container<copy_counted<T>> counted;
+        const size_t batch = 64;
+
+        std::chrono::nanoseconds elapsed;
+        size_t iterations;
+        size_t timed_allocations;
+        run_batches(batch, reusable, [&] { return setup(plain(), element_traits<T>()); }, op,
+                    opts.min_time, elapsed, iterations, timed_allocations);
+
+        std::chrono::nanoseconds ignored;
+        size_t counted_iterations;
+        size_t ignored_allocations;
+        element_traits<copy_counted<T>>::reset_copies();
+        run_batches(batch, reusable, [&] { return setup(counted(), element_traits<copy_counted<T>>()); }, op,
+                    std::chrono::nanoseconds(0), ignored, counted_iterations, ignored_allocations);
+        size_t copies = element_traits<copy_counted<T>>::copies();
+
+        double ops = static_cast<double>(iterations) * ops_per_iteration;
+        double counted_ops = static_cast<double>(counted_iterations) * ops_per_iteration;
+        return result{static_cast<double>(elapsed.count()) / ops,
+                      static_cast<double>(timed_allocations) / ops,
+                      static_cast<double>(copies * sizeof(T)) / counted_ops,
+                      iterations};
+    }
+
+    template<typename C, typename Traits>
+    C filled(size_t n, Traits) {
+        C c;
+        for (size_t i = 0; i != n; ++i) {
+            c.push_back(Traits::make(i));
+        }
+        return c;
+    }
+
+    template<typename C>
+    struct pair_state {
+        C first;
+        C second;
+    };
+
+    template<typename T>
+    using std_vector = std::vector<T>;
+
+    template<typename T>
+    using cow_vector = ::vector<T>;
+
+    bool first_record = true;
+
+    void report(char const *benchmark, char const *container, char const *type,
+                size_t n, result const &r) {
+        std::cout << (first_record ? "\n" : ",\n")
+                  << "    {\"benchmark\": \"" << benchmark
+                  << "\", \"container\": \"" << container
+                  << "\", \"type\": \"" << type
+                  << "\", \"n\": " << n
+                  << ", \"iterations\": " << r.iterations
+                  << ", \"ns_per_op\": " << r.ns_per_op
+                  << ", \"allocations_per_op\": " << r.allocations_per_op
+                  << ", \"bytes_copied_per_op\": " << r.bytes_copied_per_op << "}";
+        first_record = false;
+    }
+
+    template<template<typename> class Container, typename T>
+    void run_all(options const &opts, char const *container) {
+        const size_t n = 1000;
+        const size_t k = n / 10;
+        auto bench = [&](char const *name, size_t size, size_t ops, bool reusable, auto setup, auto op) {
+            if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+                return;
+            }
+            report(name, container, type_name<T>(), size,
+                   measure<Container, T>(opts, ops, reusable, setup, op));
+        };
+
+        auto empty = [](auto c, auto traits) {
+            return std::make_pair(c, traits.make(0));
+        };
+        auto sized = [n](auto c, auto traits) {
+            return filled<decltype(c)>(n, traits);
+        };
+        auto two_sized = [n](auto c, auto traits) {
+            pair_state<decltype(c)> s{filled<decltype(c)>(n, traits), decltype(c)()};
+            s.second = s.first;
+            // make the second container a distinct buffer with equal contents
+            s.second.push_back(traits.make(0));
+            s.second.pop_back();
+            return s;
+        };
+
+        bench("push_back_inline", 1, 1, false, empty, [](auto &s) {
+            s.first.push_back(s.second);
+            do_not_optimize(s.first);
+        });
+        bench("push_back_heap", n, n, false, [n](auto c, auto traits) {
+            return std::make_pair(c, filled<std::vector<decltype(traits.make(0))>>(n, traits));
+        }, [](auto &s) {
+            for (auto const &v : s.second) {
+                s.first.push_back(v);
+            }
+            do_not_optimize(s.first);
+        });
+        bench("copy", n, 1, true, sized, [](auto &s) {
+            auto copy = s;
+            do_not_optimize(copy);
+        });
+        bench("first_write_detach", n, 1, false, [n](auto c, auto traits) {
+            pair_state<decltype(c)> s{filled<decltype(c)>(n, traits), decltype(c)()};
+            s.second = s.first;
+            return s;
+        }, [](auto &s) {
+            s.second[0] = s.second[1];
+            do_not_optimize(s.second);
+        });
+        bench("insert_front", n, k, false, sized, [k](auto &s) {
+            for (size_t i = 0; i != k; ++i) {
+                s.insert(s.begin(), s[1]);
+            }
+            do_not_optimize(s);
+        });
+        bench("insert_middle", n, k, false, sized, [n, k](auto &s) {
+            for (size_t i = 0; i != k; ++i) {
+                s.insert(s.begin() + n / 2, s[1]);
+            }
+            do_not_optimize(s);
+        });
+        bench("insert_back", n, k, false, sized, [k](auto &s) {
+            for (size_t i = 0; i != k; ++i) {
+                s.insert(s.end(), s[1]);
+            }
+            do_not_optimize(s);
+        });
+        bench("erase_front", n, k, false, sized, [k](auto &s) {
+            for (size_t i = 0; i != k; ++i) {
+                s.erase(s.begin());
+            }
+            do_not_optimize(s);
+        });
+        bench("erase_middle", n, k, false, sized, [n, k](auto &s) {
+            for (size_t i = 0; i != k; ++i) {
+                s.erase(s.begin() + (n - i) / 2);
+            }
+            do_not_optimize(s);
+        });
+        bench("erase_back", n, k, false, sized, [k](auto &s) {
+            for (size_t i = 0; i != k; ++i) {
+                s.erase(s.end() - 1);
+            }
+            do_not_optimize(s);
+        });
+        bench("iterate", n, n, true, sized, [](auto &s) {
+            auto const &c = s;
+            size_t sum = 0;
+            for (auto const &v : c) {
+                sum += weight(v);
+            }
+            do_not_optimize(sum);
+        });
+        bench("compare", n, 1, true, two_sized, [](auto &s) {
+            bool r = s.first == s.second || s.first < s.second;
+            do_not_optimize(r);
+        });
+        bench("swap", n, 1, true, two_sized, [](auto &s) {
+            s.first.swap(s.second);
+            do_not_optimize(s);
+        });
+    }
+
+    void report_threads(char const *benchmark, char const *container, size_t threads,
+                        std::chrono::nanoseconds elapsed, size_t ops) {
+        double seconds = static_cast<double>(elapsed.count()) / 1e9;
+        std::cout << (first_record ? "\n" : ",\n")
+                  << "    {\"benchmark\": \"" << benchmark
+                  << "\", \"container\": \"" << container
+                  << "\", \"threads\": " << threads
+                  << ", \"ops\": " << ops
+                  << ", \"ops_per_second\": " << static_cast<double>(ops) / seconds
+                  << ", \"ns_per_op_per_thread\": " << static_cast<double>(elapsed.count()) * threads / ops << "}";
+        first_record = false;
+    }
+
+    // `threads` readers call read() in a loop while the calling thread calls
+    // write() every millisecond, for min_time. Returns the number of reads.
+    template<typename Read, typename Write>
+    size_t run_readers(size_t threads, std::chrono::nanoseconds min_time,
+                       Read const &read, Write const &write, std::chrono::nanoseconds &elapsed) {
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> total(0);
+        std::vector<std::thread> readers;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t != threads; ++t) {
+            readers.emplace_back([&, t] {
+                size_t count = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    read(t + count);
+                    ++count;
+                }
+                total += count;
+            });
+        }
+        while (std::chrono::steady_clock::now() - start < min_time) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            write();
+        }
+        stop = true;
+        for (auto &r : readers) {
+            r.join();
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        return total;
+    }
+
+    // Snapshot reads of a read-mostly table: versioned_vector::load against
+    // copying a vector under a mutex.
+    void run_reader_scaling(options const &opts) {
+        const char *name = "reader_scaling";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        const size_t n = 1000;
+        ::vector<int> initial = filled<::vector<int>>(n, element_traits<int>());
+        for (size_t threads = 1; threads <= 64; threads *= 2) {
+            std::chrono::nanoseconds elapsed;
+            {
+                versioned_vector<int> table(initial);
+                size_t ops = run_readers(threads, opts.min_time, [&](size_t i) {
+                    auto s = table.load();
+                    do_not_optimize((*s)[i % n]);
+                }, [&] {
+                    table.update([](::vector<int> &data) { ++data[0]; });
+                }, elapsed);
+                report_threads(name, "versioned_vector", threads, elapsed, ops);
+            }
+            {
+                std::mutex m;
+                ::vector<int> table = initial;
+                table.push_back(0);
+                size_t ops = run_readers(threads, opts.min_time, [&](size_t i) {
+                    std::lock_guard<std::mutex> lock(m);
+                    ::vector<int> const s = table;
+                    do_not_optimize(s[i % n]);
+                }, [&] {
+                    std::lock_guard<std::mutex> lock(m);
+                    ++table[0];
+                }, elapsed);
+                report_threads(name, "mutex+vector", threads, elapsed, ops);
+            }
+        }
+    }
+
+    // Copies and drops of one hot snapshot on every thread: the sharded count
+    // of versioned_vector snapshots against the single counter of shared_ptr.
+    void run_copy_scaling(options const &opts) {
+        const char *name = "snapshot_copy_scaling";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        const size_t n = 1000;
+        ::vector<int> initial = filled<::vector<int>>(n, element_traits<int>());
+        auto no_writes = [] {};
+        for (size_t threads = 1; threads <= 64; threads *= 2) {
+            std::chrono::nanoseconds elapsed;
+            {
+                versioned_vector<int> table(initial);
+                auto hot = table.load();
+                size_t ops = run_readers(threads, opts.min_time, [&](size_t i) {
+                    auto copy = hot;
+                    do_not_optimize((*copy)[i % n]);
+                }, no_writes, elapsed);
+                report_threads(name, "versioned_vector::snapshot", threads, elapsed, ops);
+            }
+            {
+                auto hot = std::make_shared<std::vector<int> const>(initial.begin(), initial.end());
+                size_t ops = run_readers(threads, opts.min_time, [&](size_t i) {
+                    auto copy = hot;
+                    do_not_optimize((*copy)[i % n]);
+                }, no_writes, elapsed);
+                report_threads(name, "std::shared_ptr", threads, elapsed, ops);
+            }
+        }
+    }
+
+    // Each pass over 4M doubles on pools of 1 to hardware_concurrency()
+    // threads, counting the caller; ops are elements processed.
+    void run_parallel_scaling(options const &opts) {
+        const std::array<char const *, 5> names = {"parallel_for_each", "parallel_transform", "parallel_reduce",
+                                                    "inclusive_scan", "parallel_fill"};
+        if (!opts.filter.empty() && std::none_of(names.begin(), names.end(), [&](char const *name) {
+            return std::string(name).find(opts.filter) != std::string::npos;
+        })) {
+            return;
+        }
+        const size_t n = size_t(1) << 22;
+        size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        ::vector<double> v;
+        v.resize(n, 1.0);
+        ::vector<double> out;
+        out.resize(n, 0.0);
+
+        auto pass = [&](char const *name, size_t threads, auto const &op) {
+            if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+                return;
+            }
+            work_stealing_pool pool(threads - 1);
+            size_t runs = 0;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                op(pool);
+                ++runs;
+            } while (std::chrono::steady_clock::now() - start < opts.min_time);
+            report_threads(name, "vector", threads, std::chrono::steady_clock::now() - start, runs * n);
+        };
+
+        for (size_t threads = 1;; threads = std::min(2 * threads, max_threads)) {
+            pass(names[0], threads, [&](work_stealing_pool &pool) {
+                parallel_for_each(v, [](double &x) { x = x * 0.5 + 0.5; }, pool);
+            });
+            pass(names[1], threads, [&](work_stealing_pool &pool) {
+                parallel_transform(v, out, [](double x) { return x * x; }, pool);
+            });
+            pass(names[2], threads, [&](work_stealing_pool &pool) {
+                do_not_optimize(parallel_reduce(v, 0.0, std::plus<double>(), pool));
+            });
+            pass(names[3], threads, [&](work_stealing_pool &pool) {
+                inclusive_scan(out, std::plus<double>(), pool);
+            });
+            pass(names[4], threads, [&](work_stealing_pool &pool) {
+                parallel_fill(out, 1.0, pool);
+            });
+            if (threads == max_threads) {
+                break;
+            }
+        }
+    }
+
+    template<typename T>
+    T random_key(std::mt19937_64 &rng) {
+        if constexpr (std::is_floating_point<T>::value) {
+            return std::uniform_real_distribution<T>(-1e9, 1e9)(rng);
+        } else {
+            return static_cast<T>(rng());
+        }
+    }
+
+    // Sorts fresh copies of one random input until min_time has passed;
+    // copying the input is not timed.
+    template<typename T, typename Sort>
+    double ns_per_element(std::vector<T> const &input, std::chrono::nanoseconds min_time, Sort const &sort) {
+        std::chrono::nanoseconds elapsed(0);
+        size_t runs = 0;
+        do {
+            ::vector<T> v(input.begin(), input.end());
+            auto start = std::chrono::steady_clock::now();
+            sort(v);
+            elapsed += std::chrono::steady_clock::now() - start;
+            ++runs;
+        } while (elapsed < min_time);
+        return static_cast<double>(elapsed.count()) / static_cast<double>(runs * input.size());
+    }
+
+    template<typename T>
+    void run_sort(options const &opts) {
+        const char *name = "sort";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        size_t threads = default_parallel_pool().size() + 1;
+        for (size_t n : opts.sort_sizes) {
+            std::mt19937_64 rng(n);
+            std::vector<T> input(n);
+            for (auto &x : input) {
+                x = random_key<T>(rng);
+            }
+            auto record = [&](char const *container, double ns) {
+                std::cout << (first_record ? "\n" : ",\n")
+                          << "    {\"benchmark\": \"" << name
+                          << "\", \"container\": \"" << container
+                          << "\", \"type\": \"" << type_name<T>()
+                          << "\", \"n\": " << n
+                          << ", \"threads\": " << threads
+                          << ", \"ns_per_element\": " << ns << "}";
+                first_record = false;
+            };
+            record("vector_sort", ns_per_element(input, opts.min_time, [](::vector<T> &v) {
+                vector_sort(v);
+            }));
+            record("std::sort", ns_per_element(input, opts.min_time, [](::vector<T> &v) {
+                std::sort(v.begin(), v.end());
+            }));
+        }
+    }
+
+    // Scans one vector of 1M ints that never contains the probe, so find and
+    // contains read the whole buffer, once per kernel set and once through
+    // the std algorithms over the vector's iterators.
+    void run_search(options const &opts) {
+        const size_t n = 1 << 20;
+        const char *names[] = {"search_find", "search_count", "search_min_element"};
+        const char *isa_names[] = {"scalar", "sse2", "avx2"};
+        std::mt19937 rng(n);
+        ::vector<int> v;
+        for (size_t i = 0; i != n; ++i) {
+            v.push_back(static_cast<int>(rng() % 1000));
+        }
+        ::vector<int> const &cv = v;
+        const int probe = -1;
+
+        auto pass = [&](char const *name, char const *container, auto const &op) {
+            if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+                return;
+            }
+            size_t runs = 0;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                op();
+                ++runs;
+            } while (std::chrono::steady_clock::now() - start < opts.min_time);
+            double ns = static_cast<double>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count());
+            std::cout << (first_record ? "\n" : ",\n")
+                      << "    {\"benchmark\": \"" << name
+                      << "\", \"container\": \"" << container
+                      << "\", \"type\": \"" << type_name<int>()
+                      << "\", \"n\": " << n
+                      << ", \"ns_per_element\": " << ns / static_cast<double>(runs * n) << "}";
+            first_record = false;
+        };
+
+        search_isa original = active_search_isa();
+        for (search_isa isa : {search_isa::scalar, search_isa::sse2, search_isa::avx2}) {
+            if (detected_search_isa() < isa) {
+                break;
+            }
+            set_search_isa(isa);
+            std::string container = std::string("vector_search/") + isa_names[static_cast<int>(isa)];
+            pass(names[0], container.c_str(), [&] { do_not_optimize(find(cv, probe)); });
+            pass(names[1], container.c_str(), [&] { do_not_optimize(count(cv, probe)); });
+            pass(names[2], container.c_str(), [&] { do_not_optimize(min_element(cv)); });
+        }
+        set_search_isa(original);
+        pass(names[0], "std", [&] { do_not_optimize(std::find(cv.begin(), cv.end(), probe)); });
+        pass(names[1], "std", [&] { do_not_optimize(std::count(cv.begin(), cv.end(), probe)); });
+        pass(names[2], "std", [&] { do_not_optimize(std::min_element(cv.begin(), cv.end())); });
+    }
+
+    // c = a * 2 + b over 1M doubles: evaluated by vector_expr into c's own
+    // buffer, and step by step through a fresh vector per operation.
+    void run_expression(options const &opts) {
+        const char *name = "expression";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        const size_t n = 1 << 20;
+        ::vector<double> a, b, c;
+        for (size_t i = 0; i != n; ++i) {
+            a.push_back(static_cast<double>(i));
+            b.push_back(static_cast<double>(n - i));
+        }
+        c = a;
+        c.data();
+
+        auto pass = [&](char const *container, auto const &op) {
+            size_t runs = 0;
+            alloc_stats_scope scope;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                op();
+                do_not_optimize(c);
+                ++runs;
+            } while (std::chrono::steady_clock::now() - start < opts.min_time);
+            double ns = static_cast<double>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count());
+            std::cout << (first_record ? "\n" : ",\n")
+                      << "    {\"benchmark\": \"" << name
+                      << "\", \"container\": \"" << container
+                      << "\", \"type\": \"double\", \"n\": " << n
+                      << ", \"ns_per_element\": " << ns / static_cast<double>(runs * n)
+                      << ", \"allocations_per_op\": "
+                      << static_cast<double>(scope.stats().allocations) / static_cast<double>(runs) << "}";
+            first_record = false;
+        };
+
+        pass("vector_expr", [&] { c = a * 2 + b; });
+        pass("temporaries", [&] {
+            ::vector<double> doubled;
+            doubled.reserve(n);
+            for (size_t i = 0; i != n; ++i) {
+                doubled.push_back(a[i] * 2);
+            }
+            ::vector<double> sum;
+            sum.reserve(n);
+            for (size_t i = 0; i != n; ++i) {
+                sum.push_back(doubled[i] + b[i]);
+            }
+            c = sum;
+        });
+    }
+
+    // a + b + c from three shared vectors of 1M ints: as a rope, as a rope
+    // flattened into one vector, and as a vector built by push_back.
+    void run_concat(options const &opts) {
+        const char *name = "concat";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        const size_t n = 1 << 20;
+        ::vector<int> pieces[3];
+        for (auto &piece : pieces) {
+            for (size_t i = 0; i != n; ++i) {
+                piece.push_back(static_cast<int>(i));
+            }
+        }
+
+        auto pass = [&](char const *container, auto const &op) {
+            size_t runs = 0;
+            alloc_stats_scope scope;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                op();
+                ++runs;
+            } while (std::chrono::steady_clock::now() - start < opts.min_time);
+            double ns = static_cast<double>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count());
+            std::cout << (first_record ? "\n" : ",\n")
+                      << "    {\"benchmark\": \"" << name
+                      << "\", \"container\": \"" << container
+                      << "\", \"type\": \"int\", \"n\": " << 3 * n
+                      << ", \"ns_per_op\": " << ns / static_cast<double>(runs)
+                      << ", \"allocations_per_op\": "
+                      << static_cast<double>(scope.stats().allocations) / static_cast<double>(runs) << "}";
+            first_record = false;
+        };
+
+        pass("rope", [&] {
+            rope<int> r = concat(pieces[0], pieces[1], pieces[2]);
+            do_not_optimize(r);
+        });
+        pass("rope_flatten", [&] {
+            ::vector<int> v = concat(pieces[0], pieces[1], pieces[2]).flatten();
+            do_not_optimize(v);
+        });
+        pass("deep_copy", [&] {
+            ::vector<int> v;
+            v.reserve(3 * n);
+            for (auto const &piece : pieces) {
+                for (size_t i = 0; i != n; ++i) {
+                    v.push_back(piece[i]);
+                }
+            }
+            do_not_optimize(v);
+        });
+    }
+
+    // Derives a new version of 1M ints by changing one element while the old
+    // version stays alive: path copying in persistent_vector, one 64 KB chunk
+    // in chunked_vector, a full block copy for a shared vector.
+    void run_versions(options const &opts) {
+        const char *name = "new_version";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        const size_t n = 1 << 20;
+        ::vector<int> base;
+        for (size_t i = 0; i != n; ++i) {
+            base.push_back(static_cast<int>(i));
+        }
+        persistent_vector<int> persistent(base);
+        chunked_vector<int> chunked(base);
+
+        auto pass = [&](char const *container, auto const &op) {
+            size_t runs = 0;
+            alloc_stats_scope scope;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                op(runs);
+                ++runs;
+            } while (std::chrono::steady_clock::now() - start < opts.min_time);
+            double ns = static_cast<double>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count());
+            std::cout << (first_record ? "\n" : ",\n")
+                      << "    {\"benchmark\": \"" << name
+                      << "\", \"container\": \"" << container
+                      << "\", \"type\": \"int\", \"n\": " << n
+                      << ", \"ns_per_op\": " << ns / static_cast<double>(runs)
+                      << ", \"allocations_per_op\": "
+                      << static_cast<double>(scope.stats().allocations) / static_cast<double>(runs) << "}";
+            first_record = false;
+        };
+
+        pass("persistent_vector", [&](size_t run) {
+            persistent_vector<int> next = persistent.set(run * 7919 % n, -1);
+            do_not_optimize(next);
+        });
+        pass("chunked_vector", [&](size_t run) {
+            chunked_vector<int> next = chunked;
+            next[run * 7919 % n] = -1;
+            do_not_optimize(next);
+        });
+        pass("vector", [&](size_t run) {
+            ::vector<int> next = base;
+            next[run * 7919 % n] = -1;
+            do_not_optimize(next);
+        });
+    }
+
+    // Fills a container with 16M ints by push_back, timing every call, and
+    // reports the slowest one next to the mean: vector and std::vector copy
+    // everything on growth, incremental_vector a couple of elements.
+    void run_growth(options const &opts) {
+        const char *name = "push_back_latency";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        const size_t n = 1 << 24;
+
+        auto pass = [&](char const *container, auto make) {
+            size_t runs = 0;
+            std::chrono::nanoseconds total(0), worst(0);
+            do {
+                auto c = make();
+                for (size_t i = 0; i != n; ++i) {
+                    auto before = std::chrono::steady_clock::now();
+                    c.push_back(static_cast<int>(i));
+                    auto took = std::chrono::steady_clock::now() - before;
+                    total += took;
+                    worst = std::max(worst, std::chrono::duration_cast<std::chrono::nanoseconds>(took));
+                }
+                do_not_optimize(c);
+                ++runs;
+            } while (total < opts.min_time);
+            std::cout << (first_record ? "\n" : ",\n")
+                      << "    {\"benchmark\": \"" << name
+                      << "\", \"container\": \"" << container
+                      << "\", \"type\": \"int\", \"n\": " << n
+                      << ", \"ns_per_op\": " << static_cast<double>(total.count()) / static_cast<double>(runs * n)
+                      << ", \"max_ns\": " << worst.count() << "}";
+            first_record = false;
+        };
+
+        pass("incremental_vector", [] { return incremental_vector<int>(); });
+        pass("vector", [] { return ::vector<int>(); });
+        pass("std::vector", [] { return std::vector<int>(); });
+    }
+
+    // Small-block churn. block_churn keeps 1024 blocks of 32 to 88 bytes (a
+    // vector header and 2 to 8 ints or doubles) alive and replaces one per
+    // op, through block_pool and through malloc; vector_churn builds a
+    // vector of 2 to 8 ints, copies it and detaches the copy.
+    void run_churn(options const &opts) {
+        auto selected = [&](char const *name) {
+            return opts.filter.empty() || std::string(name).find(opts.filter) != std::string::npos;
+        };
+
+        auto pass = [&](char const *name, char const *container, auto const &op) {
+            size_t runs = 0;
+            alloc_stats_scope scope;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                for (size_t i = 0; i != 1024; ++i) {
+                    op(runs + i);
+                }
+                runs += 1024;
+            } while (std::chrono::steady_clock::now() - start < opts.min_time);
+            double ns = static_cast<double>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count());
+            std::cout << (first_record ? "\n" : ",\n")
+                      << "    {\"benchmark\": \"" << name
+                      << "\", \"container\": \"" << container
+                      << "\", \"ns_per_op\": " << ns / static_cast<double>(runs)
+                      << ", \"allocations_per_op\": "
+                      << static_cast<double>(scope.stats().allocations) / static_cast<double>(runs) << "}";
+            first_record = false;
+        };
+
+        const size_t live = 1024;
+        auto size_of = [](size_t i) {
+            return 24 + (i * 7919 % 8 + 1) * 8;
+        };
+        if (selected("block_churn")) {
+            std::vector<void *> blocks(live);
+            std::vector<size_t> sizes(live);
+            for (size_t i = 0; i != live; ++i) {
+                sizes[i] = size_of(i);
+                blocks[i] = block_pool::allocate(sizes[i]);
+            }
+            pass("block_churn", "block_pool", [&](size_t i) {
+                size_t k = i * 613 % live;
+                block_pool::deallocate(blocks[k], sizes[k]);
+                sizes[k] = size_of(i);
+                blocks[k] = block_pool::allocate(sizes[k]);
+            });
+            for (size_t i = 0; i != live; ++i) {
+                block_pool::deallocate(blocks[i], sizes[i]);
+                sizes[i] = size_of(i);
+                blocks[i] = std::malloc(sizes[i]);
+            }
+            pass("block_churn", "malloc", [&](size_t i) {
+                size_t k = i * 613 % live;
+                std::free(blocks[k]);
+                blocks[k] = std::malloc(size_of(i));
+            });
+            for (void *p : blocks) {
+                std::free(p);
+            }
+        }
+        if (selected("vector_churn")) {
+            auto churn = [](auto v, size_t i) {
+                size_t n = 2 + i % 7;
+                for (size_t k = 0; k != n; ++k) {
+                    v.push_back(static_cast<int>(k));
+                }
+                auto copy = v;
+                copy[0] = static_cast<int>(i);
+                do_not_optimize(copy);
+            };
+            pass("vector_churn", "vector/block_pool", [&](size_t i) {
+                churn(::vector<int, pooled_vector_policy>(), i);
+            });
+            pass("vector_churn", "vector/operator_new", [&](size_t i) {
+                churn(::vector<int>(), i);
+            });
+            pass("vector_churn", "vector/recycling", [&](size_t i) {
+                churn(::vector<int, recycling_vector_policy<>>(), i);
+            });
+            pass("vector_churn", "vector/recycling+block_pool", [&](size_t i) {
+                churn(::vector<int, recycling_vector_policy<pooled_vector_policy>>(), i);
+            });
+        }
+    }
+
+    // Latency of dropping the last reference to a vector of 1M heap-allocated
+    // strings, destroyed inline and handed to the deferred_destruction
+    // reclaimer; the reclaimer is drained between drops, untimed.
+    void run_drop(options const &opts) {
+        const char *name = "drop_latency";
+        if (!opts.filter.empty() && std::string(name).find(opts.filter) == std::string::npos) {
+            return;
+        }
+        const size_t n = 1 << 20;
+
+        auto pass = [&](char const *container, auto make) {
+            size_t runs = 0;
+            std::chrono::nanoseconds total(0), worst(0);
+            do {
+                auto v = make();
+                for (size_t i = 0; i != n; ++i) {
+                    v.push_back(std::string(32, static_cast<char>('a' + i % 26)));
+                }
+                auto before = std::chrono::steady_clock::now();
+                v = decltype(v)();
+                auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - before);
+                deferred_destruction::drain();
+                total += took;
+                worst = std::max(worst, took);
+                ++runs;
+            } while (total < opts.min_time && runs < 64);
+            std::cout << (first_record ? "\n" : ",\n")
+                      << "    {\"benchmark\": \"" << name
+                      << "\", \"container\": \"" << container
+                      << "\", \"type\": \"std::string\", \"n\": " << n
+                      << ", \"ns_per_op\": " << static_cast<double>(total.count()) / static_cast<double>(runs)
+                      << ", \"max_ns\": " << worst.count() << "}";
+            first_record = false;
+        };
+
+        pass("vector", [] { return ::vector<std::string>(); });
+        pass("vector/deferred", [] { return ::vector<std::string, deferred_vector_policy<>>(); });
+    }
+
+    template<typename T>
+    void run_type(options const &opts) {
+        run_all<cow_vector, T>(opts, "vector");
+        run_all<std_vector, T>(opts, "std::vector");
+    }
+}
+
+int main(int argc, char **argv) {
+    options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--min-time-ms" && i + 1 < argc) {
+            opts.min_time = std::chrono::milliseconds(std::atol(argv[++i]));
+        } else if (arg == "--filter" && i + 1 < argc) {
+            opts.filter = argv[++i];
+        } else if (arg == "--sort-sizes" && i + 1 < argc) {
+            opts.sort_sizes.clear();
+            std::istringstream sizes(argv[++i]);
+            for (std::string size; std::getline(sizes, size, ',');) {
+                opts.sort_sizes.push_back(std::stoul(size));
+            }
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--min-time-ms N] [--filter SUBSTRING] [--sort-sizes N,N,...]\n";
+            return 1;
+        }
+    }
+
+    std::cout << "{\n  \"benchmarks\": [";
+    run_type<int>(opts);
+    run_type<pod64>(opts);
+    run_type<std::string>(opts);
+    run_reader_scaling(opts);
+    run_copy_scaling(opts);
+    run_parallel_scaling(opts);
+    run_sort<std::uint64_t>(opts);
+    run_sort<float>(opts);
+    run_search(opts);
+    run_expression(opts);
+    run_concat(opts);
+    run_versions(opts);
+    run_growth(opts);
+    run_churn(opts);
+    run_drop(opts);
+    std::cout << "\n  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,239 @@
+#ifndef VECTOR_VECTOR_EXPR_H
+#define VECTOR_VECTOR_EXPR_H
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+#include "vector.h"
+
+// Lazy element-wise arithmetic on vectors of arithmetic types.
+//
+// With this header included, +, -, * and / between vectors, expressions and
+// scalars, and unary -, build a vector_expr instead of a vector. Assigning
+// the expression to a vector (or constructing one from it) evaluates every
+// element in one loop, straight into the destination's buffer: `c = a * 2 + b`
+// walks a and b once and allocates nothing when c already owns a large enough
+// block. The destination may also appear in the expression.
+//
+// An expression refers to the storage of its vector operands, so it must be
+// evaluated before they change or go away; in practice, within the statement
+// that builds it. Operands must have equal sizes. Scalars are converted to the
+// element type, and all arithmetic is done in the element type.
+
+namespace expr_detail {
+    template<typename T>
+    struct leaf {
+        typedef T value_type;
+
+        T const *data;
+        size_t n;
+
+        size_t size() const noexcept {
+            return n;
+        }
+
+        T operator[](size_t i) const noexcept {
+            return data[i];
+        }
+    };
+
+    template<typename T>
+    struct scalar {
+        typedef T value_type;
+
+        T value;
+
+        T operator[](size_t) const noexcept {
+            return value;
+        }
+    };
+
+    template<typename Op, typename L, typename R>
+    struct binary {
+        typedef typename L::value_type value_type;
+
+        L left;
+        R right;
+        size_t n;
+
+        size_t size() const noexcept {
+            return n;
+        }
+
+        value_type operator[](size_t i) const {
+            return Op()(left[i], right[i]);
+        }
+    };
+
+    template<typename Op, typename E>
+    struct unary {
+        typedef typename E::value_type value_type;
+
+        E operand;
+
+        size_t size() const noexcept {
+            return operand.size();
+        }
+
+        value_type operator[](size_t i) const {
+            return Op()(operand[i]);
+        }
+    };
+}
+
+template<typename Node>
+class vector_expr {
+public:
+    typedef typename Node::value_type value_type;
+    // marks the type for the converting members of vector
+    typedef void vector_expression;
+
+    explicit vector_expr(Node node) : node(node) {}
+
+    size_t size() const noexcept {
+        return node.size();
+    }
+
+    value_type operator[](size_t i) const {
+        return node[i];
+    }
+
+    // The fused pass: one loop over plain pointers, which the compiler can
+    // vectorize once the node tree is inlined.
+    void evaluate(value_type *out) const {
+        size_t n = node.size();
+        for (size_t i = 0; i != n; ++i) {
+            out[i] = node[i];
+        }
+    }
+
+    Node const &tree() const noexcept {
+        return node;
+    }
+
+private:
+    Node node;
+};
+
+namespace expr_detail {
+    // How each kind of operand enters the tree. Only vectors and expressions
+    // can start an expression; a scalar is accepted next to one of them.
+    template<typename X, typename = void>
+    struct operand {
+        static constexpr bool is_array = false;
+        static constexpr bool is_scalar = false;
+    };
+
+    template<typename T>
+    struct operand<vector<T>, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+        static constexpr bool is_array = true;
+        static constexpr bool is_scalar = false;
+        typedef T value_type;
+
+        static leaf<T> node(vector<T> const &v) {
+            return {v.data(), v.size()};
+        }
+    };
+
+    template<typename Node>
+    struct operand<vector_expr<Node>> {
+        static constexpr bool is_array = true;
+        static constexpr bool is_scalar = false;
+        typedef typename Node::value_type value_type;
+
+        static Node node(vector_expr<Node> const &e) {
+            return e.tree();
+        }
+    };
+
+    template<typename X>
+    struct operand<X, typename std::enable_if<std::is_arithmetic<X>::value>::type> {
+        static constexpr bool is_array = false;
+        static constexpr bool is_scalar = true;
+    };
+
+    template<typename A, typename B, typename = void>
+    struct common {
+        static constexpr bool valid = false;
+    };
+
+    template<typename A, typename B>
+    struct common<A, B, typename std::enable_if<operand<A>::is_array && operand<B>::is_array>::type> {
+        typedef typename operand<A>::value_type value_type;
+        static constexpr bool valid = std::is_same<value_type, typename operand<B>::value_type>::value;
+    };
+
+    template<typename A, typename B>
+    struct common<A, B, typename std::enable_if<operand<A>::is_array && operand<B>::is_scalar>::type> {
+        typedef typename operand<A>::value_type value_type;
+        static constexpr bool valid = true;
+    };
+
+    template<typename A, typename B>
+    struct common<A, B, typename std::enable_if<operand<A>::is_scalar && operand<B>::is_array>::type> {
+        typedef typename operand<B>::value_type value_type;
+        static constexpr bool valid = true;
+    };
+
+    template<typename T, typename X>
+    auto node(X const &x) {
+        if constexpr (operand<X>::is_scalar) {
+            return scalar<T>{static_cast<T>(x)};
+        } else {
+            return operand<X>::node(x);
+        }
+    }
+
+    template<typename X>
+    size_t length(X const &x) {
+        if constexpr (operand<X>::is_scalar) {
+            return 0;
+        } else {
+            return x.size();
+        }
+    }
+
+    template<template<typename> class Op, typename A, typename B>
+    auto combine(A const &a, B const &b) {
+        typedef typename common<A, B>::value_type T;
+        auto l = node<T>(a);
+        auto r = node<T>(b);
+        size_t n = operand<A>::is_scalar ? length(b) : length(a);
+        assert(operand<A>::is_scalar || operand<B>::is_scalar || length(a) == length(b));
+        return vector_expr<binary<Op<T>, decltype(l), decltype(r)>>({l, r, n});
+    }
+
+    template<typename A, typename B>
+    using enable_binary = typename std::enable_if<common<A, B>::valid>::type;
+}
+
+template<typename A, typename B, typename = expr_detail::enable_binary<A, B>>
+auto operator+(A const &a, B const &b) {
+    return expr_detail::combine<std::plus>(a, b);
+}
+
+template<typename A, typename B, typename = expr_detail::enable_binary<A, B>>
+auto operator-(A const &a, B const &b) {
+    return expr_detail::combine<std::minus>(a, b);
+}
+
+template<typename A, typename B, typename = expr_detail::enable_binary<A, B>>
+auto operator*(A const &a, B const &b) {
+    return expr_detail::combine<std::multiplies>(a, b);
+}
+
+template<typename A, typename B, typename = expr_detail::enable_binary<A, B>>
+auto operator/(A const &a, B const &b) {
+    return expr_detail::combine<std::divides>(a, b);
+}
+
+template<typename A, typename = typename std::enable_if<expr_detail::operand<A>::is_array>::type>
+auto operator-(A const &a) {
+    typedef typename expr_detail::operand<A>::value_type T;
+    auto e = expr_detail::operand<A>::node(a);
+    return vector_expr<expr_detail::unary<std::negate<T>, decltype(e)>>({e});
+}
+
+#endif //VECTOR_VECTOR_EXPR_H
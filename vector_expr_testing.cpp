@@ -0,0 +1,100 @@
+#include <cstdint>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "gtest/gtest.h"
+#include "vector_expr.h"
+
+namespace
+{
+    template <typename T>
+    vector<T> iota(size_t n, T first)
+    {
+        vector<T> v;
+        for (size_t i = 0; i != n; ++i)
+            v.push_back(static_cast<T>(first + static_cast<T>(i)));
+        return v;
+    }
+}
+
+TEST(vector_expr, evaluates_elementwise)
+{
+    vector<double> a = iota<double>(100, 1);
+    vector<double> b = iota<double>(100, -50);
+    vector<double> c = a * 2 + b;
+    ASSERT_EQ(100u, c.size());
+    for (size_t i = 0; i != c.size(); ++i)
+        EXPECT_EQ(a[i] * 2 + b[i], c[i]);
+
+    c = -(a - b) / 4 + 1.5 * a;
+    for (size_t i = 0; i != c.size(); ++i)
+        EXPECT_EQ(-(a[i] - b[i]) / 4 + 1.5 * a[i], c[i]);
+}
+
+TEST(vector_expr, integer_arithmetic)
+{
+    vector<std::int32_t> a = iota<std::int32_t>(37, -10);
+    vector<std::int32_t> c = (a * a - 3) / 2;
+    ASSERT_EQ(37u, c.size());
+    for (size_t i = 0; i != c.size(); ++i)
+        EXPECT_EQ((a[i] * a[i] - 3) / 2, c[i]);
+}
+
+TEST(vector_expr, reuses_unique_buffer)
+{
+    vector<double> a = iota<double>(1000, 0);
+    vector<double> b = iota<double>(1000, 1);
+    vector<double> c = iota<double>(1000, 2);
+    double const* buffer = std::as_const(c).data();
+
+    alloc_stats_scope s;
+    c = a * 2 + b;
+    EXPECT_EQ(0u, s.stats().allocations);
+    EXPECT_EQ(buffer, std::as_const(c).data());
+    EXPECT_EQ(999.0 * 2 + 1000, c[999]);
+}
+
+TEST(vector_expr, shared_destination_gets_new_buffer)
+{
+    vector<double> a = iota<double>(50, 0);
+    vector<double> c = iota<double>(50, 10);
+    vector<double> d = c;
+
+    c = a + c;
+    for (size_t i = 0; i != 50; ++i)
+    {
+        EXPECT_EQ(10.0 + static_cast<double>(i), d[i]);
+        EXPECT_EQ(10.0 + 2.0 * static_cast<double>(i), c[i]);
+    }
+}
+
+TEST(vector_expr, destination_in_expression)
+{
+    vector<float> a = iota<float>(64, 0);
+    vector<float> b = a;
+    a = a * a + a;
+    for (size_t i = 0; i != 64; ++i)
+        EXPECT_EQ(b[i] * b[i] + b[i], a[i]);
+}
+
+TEST(vector_expr, resizes_destination)
+{
+    vector<int> a = iota<int>(20, 0);
+    vector<int> c = iota<int>(5, 0);
+    c = a + 1;
+    ASSERT_EQ(20u, c.size());
+    EXPECT_EQ(20, c[19]);
+
+    vector<int> one = iota<int>(1, 7);
+    c = one * 3;
+    ASSERT_EQ(1u, c.size());
+    EXPECT_EQ(21, c[0]);
+
+    one = one - one;
+    ASSERT_EQ(1u, one.size());
+    EXPECT_EQ(0, one[0]);
+
+    vector<int> empty;
+    c = empty + 1;
+    EXPECT_TRUE(c.empty());
+}
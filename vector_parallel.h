@@ -0,0 +1,175 @@
+#ifndef VECTOR_VECTOR_PARALLEL_H
+#define VECTOR_VECTOR_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+#include "vector.h"
+#include "work_stealing_pool.h"
+
+// Data-parallel passes over a vector's contiguous storage.
+//
+// Every algorithm detaches the output buffer once, on the calling thread,
+// through data(); the chunks handed to the pool then work on raw pointers.
+// The caller takes part in the work while it waits, so a pool of k workers
+// runs k + 1 chunks at once. A pool serves one caller at a time: a call made
+// while another thread uses the pool, or from inside one of its tasks, runs
+// its chunks one after the other on the calling thread instead.
+//
+// Operations passed to parallel_reduce and inclusive_scan must be
+// associative; chunks are combined in order, so they need not commute.
+
+// Pool used when none is passed: hardware_concurrency() threads counting the
+// caller, shared by the whole process and created on first use.
+inline work_stealing_pool &default_parallel_pool() {
+    static work_stealing_pool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+namespace parallel_detail {
+    // Below this many elements per chunk, splitting costs more than it saves.
+    constexpr size_t min_grain = 4096;
+
+    inline size_t chunk_count(work_stealing_pool &pool, size_t n) {
+        size_t by_threads = 4 * (pool.size() + 1);
+        size_t by_grain = (n + min_grain - 1) / min_grain;
+        return std::max<size_t>(1, std::min(by_threads, by_grain));
+    }
+
+    // Calls f(chunk, first, last) for `chunks` consecutive ranges of [0, n).
+    template<typename F>
+    void for_chunks(work_stealing_pool &pool, size_t n, size_t chunks, F const &f) {
+        if (chunks == 1 || pool.is_worker() || !pool.try_claim()) {
+            for (size_t c = 0; c != chunks; ++c) {
+                f(c, n * c / chunks, n * (c + 1) / chunks);
+            }
+            return;
+        }
+        struct claim {
+            work_stealing_pool &pool;
+
+            ~claim() {
+                pool.release_claim();
+            }
+        } held{pool};
+        try {
+            for (size_t c = 0; c != chunks; ++c) {
+                size_t first = n * c / chunks;
+                size_t last = n * (c + 1) / chunks;
+                pool.submit([&f, c, first, last] { f(c, first, last); });
+            }
+        } catch (...) {
+            // the queued chunks refer to f and to the caller's buffers
+            try {
+                pool.wait();
+            } catch (...) {
+            }
+            throw;
+        }
+        pool.wait();
+    }
+}
+
+template<typename T, typename Policy, typename F>
+void parallel_for_each(vector<T, Policy> &v, F f, work_stealing_pool &pool = default_parallel_pool()) {
+    size_t n = v.size();
+    T *data = v.data();
+    parallel_detail::for_chunks(pool, n, parallel_detail::chunk_count(pool, n), [&](size_t, size_t first, size_t last) {
+        std::for_each(data + first, data + last, f);
+    });
+}
+
+// Stores f(in[i]) into out[i]; out is resized to in.size() first.
+// in and out may be the same vector.
+template<typename T, typename P, typename U, typename Q, typename F>
+void parallel_transform(vector<T, P> const &in, vector<U, Q> &out, F f,
+                        work_stealing_pool &pool = default_parallel_pool()) {
+    size_t n = in.size();
+    if (out.size() != n) {
+        out.resize(n, U());
+    }
+    U *dst = out.data();
+    T const *src = in.data();
+    parallel_detail::for_chunks(pool, n, parallel_detail::chunk_count(pool, n), [&](size_t, size_t first, size_t last) {
+        std::transform(src + first, src + last, dst + first, f);
+    });
+}
+
+template<typename T, typename Policy, typename Op = std::plus<T>>
+T parallel_reduce(vector<T, Policy> const &v, typename vector<T, Policy>::value_type init, Op op = Op(),
+                  work_stealing_pool &pool = default_parallel_pool()) {
+    size_t n = v.size();
+    if (n == 0) {
+        return init;
+    }
+    T const *data = v.data();
+    size_t chunks = parallel_detail::chunk_count(pool, n);
+    vector<T> partial;
+    partial.resize(chunks, data[0]);
+    T *partial_data = partial.data();
+    parallel_detail::for_chunks(pool, n, chunks, [&](size_t c, size_t first, size_t last) {
+        T sum = data[first];
+        for (size_t i = first + 1; i != last; ++i) {
+            sum = op(sum, data[i]);
+        }
+        partial_data[c] = sum;
+    });
+    for (size_t c = 0; c != chunks; ++c) {
+        init = op(init, partial_data[c]);
+    }
+    return init;
+}
+
+// In place: v[i] becomes v[0] op ... op v[i]. Each chunk is reduced, the
+// chunk totals are scanned serially, then every chunk is scanned again
+// starting from the total of the chunks before it.
+template<typename T, typename Policy, typename Op = std::plus<T>>
+void inclusive_scan(vector<T, Policy> &v, Op op = Op(), work_stealing_pool &pool = default_parallel_pool()) {
+    size_t n = v.size();
+    if (n == 0) {
+        return;
+    }
+    T *data = v.data();
+    size_t chunks = parallel_detail::chunk_count(pool, n);
+    if (chunks == 1) {
+        for (size_t i = 1; i != n; ++i) {
+            data[i] = op(data[i - 1], data[i]);
+        }
+        return;
+    }
+    vector<T> total;
+    total.resize(chunks, data[0]);
+    T *total_data = total.data();
+    parallel_detail::for_chunks(pool, n, chunks, [&](size_t c, size_t first, size_t last) {
+        T sum = data[first];
+        for (size_t i = first + 1; i != last; ++i) {
+            sum = op(sum, data[i]);
+        }
+        total_data[c] = sum;
+    });
+    for (size_t c = 1; c != chunks; ++c) {
+        total_data[c] = op(total_data[c - 1], total_data[c]);
+    }
+    parallel_detail::for_chunks(pool, n, chunks, [&](size_t c, size_t first, size_t last) {
+        if (c != 0) {
+            data[first] = op(total_data[c - 1], data[first]);
+        }
+        for (size_t i = first + 1; i != last; ++i) {
+            data[i] = op(data[i - 1], data[i]);
+        }
+    });
+}
+
+template<typename T, typename Policy>
+void parallel_fill(vector<T, Policy> &v, typename vector<T, Policy>::value_type const &value,
+                   work_stealing_pool &pool = default_parallel_pool()) {
+    size_t n = v.size();
+    T *data = v.data();
+    parallel_detail::for_chunks(pool, n, parallel_detail::chunk_count(pool, n), [&](size_t, size_t first, size_t last) {
+        std::fill(data + first, data + last, value);
+    });
+}
+
+#endif //VECTOR_VECTOR_PARALLEL_H
@@ -0,0 +1,196 @@
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fault_injection.h"
+#include "gtest/gtest.h"
+#include "vector_parallel.h"
+#include "vector_stats.h"
+
+namespace
+{
+    vector<std::int64_t> iota(size_t n)
+    {
+        vector<std::int64_t> v;
+        for (size_t i = 0; i != n; ++i)
+            v.push_back(static_cast<std::int64_t>(i));
+        return v;
+    }
+
+    // sizes around the inline, single-chunk and multi-chunk cases
+    const size_t sizes[] = {0, 1, 2, 4095, 4096, 100000};
+}
+
+TEST(vector_parallel, for_each_detaches)
+{
+    work_stealing_pool pool(3);
+    for (size_t n : sizes)
+    {
+        vector<std::int64_t> a = iota(n);
+        vector<std::int64_t> b = a;
+        parallel_for_each(b, [](std::int64_t& x) { x *= 2; }, pool);
+        for (size_t i = 0; i != n; ++i)
+        {
+            EXPECT_EQ(static_cast<std::int64_t>(i), a[i]);
+            EXPECT_EQ(2 * static_cast<std::int64_t>(i), b[i]);
+        }
+    }
+}
+
+TEST(vector_parallel, transform)
+{
+    work_stealing_pool pool(3);
+    for (size_t n : sizes)
+    {
+        vector<std::int64_t> in = iota(n);
+        vector<std::string> out;
+        parallel_transform(in, out, [](std::int64_t x) { return std::to_string(x); }, pool);
+        ASSERT_EQ(n, out.size());
+        for (size_t i = 0; i != n; ++i)
+            EXPECT_EQ(std::to_string(i), out[i]);
+
+        parallel_transform(in, in, [](std::int64_t x) { return x + 1; }, pool);
+        for (size_t i = 0; i != n; ++i)
+            EXPECT_EQ(static_cast<std::int64_t>(i) + 1, in[i]);
+    }
+}
+
+TEST(vector_parallel, reduce)
+{
+    work_stealing_pool pool(3);
+    for (size_t n : sizes)
+    {
+        vector<std::int64_t> v = iota(n);
+        std::int64_t expected = static_cast<std::int64_t>(n) * (static_cast<std::int64_t>(n) - 1) / 2;
+        EXPECT_EQ(expected + 7, parallel_reduce(v, std::int64_t(7), std::plus<std::int64_t>(), pool));
+    }
+
+    // associative but not commutative: chunks must be combined in order
+    vector<std::string> words;
+    std::string expected;
+    for (size_t i = 0; i != 20000; ++i)
+    {
+        words.push_back(std::string(1, static_cast<char>('a' + i % 26)));
+        expected += words[i];
+    }
+    EXPECT_EQ(">" + expected, parallel_reduce(words, std::string(">"), std::plus<std::string>(), pool));
+}
+
+TEST(vector_parallel, inclusive_scan)
+{
+    work_stealing_pool pool(3);
+    for (size_t n : sizes)
+    {
+        vector<std::int64_t> a = iota(n);
+        vector<std::int64_t> b = a;
+        inclusive_scan(b, std::plus<std::int64_t>(), pool);
+        std::int64_t sum = 0;
+        for (size_t i = 0; i != n; ++i)
+        {
+            sum += static_cast<std::int64_t>(i);
+            EXPECT_EQ(sum, b[i]);
+            EXPECT_EQ(static_cast<std::int64_t>(i), a[i]);
+        }
+    }
+}
+
+TEST(vector_parallel, fill)
+{
+    for (size_t n : sizes)
+    {
+        vector<std::int64_t> a = iota(n);
+        vector<std::int64_t> b = a;
+        parallel_fill(b, std::int64_t(42));
+        for (size_t i = 0; i != n; ++i)
+        {
+            EXPECT_EQ(static_cast<std::int64_t>(i), a[i]);
+            EXPECT_EQ(42, b[i]);
+        }
+    }
+}
+
+TEST(vector_parallel, exception_propagates)
+{
+    work_stealing_pool pool(3);
+    vector<std::int64_t> v = iota(100000);
+    EXPECT_THROW(parallel_for_each(v, [](std::int64_t& x)
+                                   {
+                                       if (x == 54321)
+                                           throw std::runtime_error("bad element");
+                                   }, pool), std::runtime_error);
+}
+
+TEST(vector_parallel, nested_calls_run_serially)
+{
+    work_stealing_pool pool(3);
+    vector<std::int64_t> const table = iota(2 * 4096);
+    vector<std::int64_t> v = iota(2 * 4096);
+    // both calls split into several chunks; the inner ones come from the
+    // workers and from the caller helping out
+    parallel_for_each(v, [&](std::int64_t& x)
+                      {
+                          x = parallel_reduce(table, std::int64_t(0), std::plus<std::int64_t>(), pool);
+                      }, pool);
+    for (size_t i = 0; i != v.size(); ++i)
+        EXPECT_EQ(8191 * 8192 / 2, v[i]);
+}
+
+TEST(vector_parallel, default_pool_is_shared)
+{
+    work_stealing_pool* pools[4] = {};
+    std::vector<std::thread> threads;
+    for (int t = 0; t != 4; ++t)
+        threads.emplace_back([&pools, t]
+                             {
+                                 pools[t] = &default_parallel_pool();
+                                 for (int round = 0; round != 20; ++round)
+                                 {
+                                     vector<std::int64_t> v = iota(100000);
+                                     parallel_fill(v, std::int64_t(t));
+                                     EXPECT_EQ(100000 * t, parallel_reduce(v, std::int64_t(0)));
+                                 }
+                             });
+    for (auto& thread : threads)
+        thread.join();
+    for (int t = 0; t != 4; ++t)
+        EXPECT_EQ(&default_parallel_pool(), pools[t]);
+}
+
+TEST(vector_parallel, failed_submit_waits_for_queued_chunks)
+{
+    work_stealing_pool pool(3);
+    std::atomic<size_t> runs(0);
+    // the chunk tasks are too large for std::function's inline buffer, so
+    // submitting allocates on the calling thread and may fail part way
+    parallel_faulty_run([&pool, &runs]
+                        {
+                            runs++;
+                            vector<std::int64_t> v;
+                            {
+                                fault_injection_disable dg;
+                                v = iota(100000);
+                            }
+                            parallel_for_each(v, [](std::int64_t& x) { x += 1; }, pool);
+                            EXPECT_EQ(100000, v[99999]);
+                        }, 1);
+    EXPECT_LT(1u, runs.load());
+}
+
+TEST(vector_parallel, any_policy)
+{
+    work_stealing_pool pool(3);
+    vector<double, vector_stats_policy> v;
+    for (int i = 0; i != 100000; ++i)
+        v.push_back(1);
+    vector<std::int64_t> out;
+    parallel_transform(v, out, [](double x) { return static_cast<std::int64_t>(2 * x); }, pool);
+    EXPECT_EQ(200000, parallel_reduce(out, 0, std::plus<std::int64_t>(), pool));
+    parallel_fill(v, 3, pool);
+    parallel_for_each(v, [](double& x) { x += 1; }, pool);
+    EXPECT_EQ(400000.0, parallel_reduce(v, 0, std::plus<double>(), pool));
+    inclusive_scan(v, std::plus<double>(), pool);
+    EXPECT_EQ(400000.0, v[99999]);
+}
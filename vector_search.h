@@ -0,0 +1,450 @@
+#ifndef VECTOR_VECTOR_SEARCH_H
+#define VECTOR_VECTOR_SEARCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "vector.h"
+
+// Linear scans over a vector's storage: find, count, contains, min_element,
+// max_element and minmax.
+//
+// For int32_t, uint32_t and float elements on x86 the scans run SSE2 or AVX2
+// kernels, picked at run time from the CPU's features; every other element
+// type, and other CPUs, use scalar loops over data(). Results match the
+// standard algorithms, except that minmax skips NaN elements other than the
+// first, as min_element and max_element do.
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define VECTOR_SEARCH_SIMD 1
+#include <immintrin.h>
+#else
+#define VECTOR_SEARCH_SIMD 0
+#endif
+
+enum class search_isa {
+    scalar, sse2, avx2
+};
+
+namespace search_detail {
+#if VECTOR_SEARCH_SIMD
+    struct sse2_i32 {
+        typedef std::int32_t value_type;
+        typedef __m128i reg;
+        static constexpr size_t width = 4;
+
+        static reg load(value_type const *p) {
+            return _mm_loadu_si128(reinterpret_cast<reg const *>(p));
+        }
+
+        static void store(value_type *p, reg r) {
+            _mm_storeu_si128(reinterpret_cast<reg *>(p), r);
+        }
+
+        static reg set1(value_type x) {
+            return _mm_set1_epi32(x);
+        }
+
+        static int eq_mask(reg a, reg b) {
+            return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)));
+        }
+
+        // SSE2 has no 32-bit min/max: select through a greater-than mask
+        static reg min(reg a, reg b) {
+            reg a_greater = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(a_greater, b), _mm_andnot_si128(a_greater, a));
+        }
+
+        static reg max(reg a, reg b) {
+            reg a_greater = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(a_greater, a), _mm_andnot_si128(a_greater, b));
+        }
+    };
+
+    struct sse2_u32 {
+        typedef std::uint32_t value_type;
+        typedef __m128i reg;
+        static constexpr size_t width = 4;
+
+        static reg load(value_type const *p) {
+            return _mm_loadu_si128(reinterpret_cast<reg const *>(p));
+        }
+
+        static void store(value_type *p, reg r) {
+            _mm_storeu_si128(reinterpret_cast<reg *>(p), r);
+        }
+
+        static reg set1(value_type x) {
+            return _mm_set1_epi32(static_cast<int>(x));
+        }
+
+        static int eq_mask(reg a, reg b) {
+            return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)));
+        }
+
+        // unsigned order is signed order with the sign bits flipped
+        static reg a_greater(reg a, reg b) {
+            reg sign = _mm_set1_epi32(INT32_MIN);
+            return _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+        }
+
+        static reg min(reg a, reg b) {
+            reg gt = a_greater(a, b);
+            return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+        }
+
+        static reg max(reg a, reg b) {
+            reg gt = a_greater(a, b);
+            return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+        }
+    };
+
+    struct sse2_f32 {
+        typedef float value_type;
+        typedef __m128 reg;
+        static constexpr size_t width = 4;
+
+        static reg load(value_type const *p) {
+            return _mm_loadu_ps(p);
+        }
+
+        static void store(value_type *p, reg r) {
+            _mm_storeu_ps(p, r);
+        }
+
+        static reg set1(value_type x) {
+            return _mm_set1_ps(x);
+        }
+
+        static int eq_mask(reg a, reg b) {
+            return _mm_movemask_ps(_mm_cmpeq_ps(a, b));
+        }
+
+        // minps/maxps return the second operand when either is NaN
+        static reg min(reg a, reg b) {
+            return _mm_min_ps(a, b);
+        }
+
+        static reg max(reg a, reg b) {
+            return _mm_max_ps(a, b);
+        }
+    };
+
+    namespace sse2 {
+#include "vector_search_kernels.h"
+    }
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+    struct avx2_i32 {
+        typedef std::int32_t value_type;
+        typedef __m256i reg;
+        static constexpr size_t width = 8;
+
+        static reg load(value_type const *p) {
+            return _mm256_loadu_si256(reinterpret_cast<reg const *>(p));
+        }
+
+        static void store(value_type *p, reg r) {
+            _mm256_storeu_si256(reinterpret_cast<reg *>(p), r);
+        }
+
+        static reg set1(value_type x) {
+            return _mm256_set1_epi32(x);
+        }
+
+        static int eq_mask(reg a, reg b) {
+            return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+        }
+
+        static reg min(reg a, reg b) {
+            return _mm256_min_epi32(a, b);
+        }
+
+        static reg max(reg a, reg b) {
+            return _mm256_max_epi32(a, b);
+        }
+    };
+
+    struct avx2_u32 {
+        typedef std::uint32_t value_type;
+        typedef __m256i reg;
+        static constexpr size_t width = 8;
+
+        static reg load(value_type const *p) {
+            return _mm256_loadu_si256(reinterpret_cast<reg const *>(p));
+        }
+
+        static void store(value_type *p, reg r) {
+            _mm256_storeu_si256(reinterpret_cast<reg *>(p), r);
+        }
+
+        static reg set1(value_type x) {
+            return _mm256_set1_epi32(static_cast<int>(x));
+        }
+
+        static int eq_mask(reg a, reg b) {
+            return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+        }
+
+        static reg min(reg a, reg b) {
+            return _mm256_min_epu32(a, b);
+        }
+
+        static reg max(reg a, reg b) {
+            return _mm256_max_epu32(a, b);
+        }
+    };
+
+    struct avx2_f32 {
+        typedef float value_type;
+        typedef __m256 reg;
+        static constexpr size_t width = 8;
+
+        static reg load(value_type const *p) {
+            return _mm256_loadu_ps(p);
+        }
+
+        static void store(value_type *p, reg r) {
+            _mm256_storeu_ps(p, r);
+        }
+
+        static reg set1(value_type x) {
+            return _mm256_set1_ps(x);
+        }
+
+        static int eq_mask(reg a, reg b) {
+            return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+        }
+
+        static reg min(reg a, reg b) {
+            return _mm256_min_ps(a, b);
+        }
+
+        static reg max(reg a, reg b) {
+            return _mm256_max_ps(a, b);
+        }
+    };
+
+    namespace avx2 {
+#include "vector_search_kernels.h"
+    }
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+    template<typename T>
+    struct lanes {
+        static constexpr bool simd = false;
+    };
+
+    template<>
+    struct lanes<std::int32_t> {
+        static constexpr bool simd = true;
+        typedef sse2_i32 sse2;
+        typedef avx2_i32 avx2;
+    };
+
+    template<>
+    struct lanes<std::uint32_t> {
+        static constexpr bool simd = true;
+        typedef sse2_u32 sse2;
+        typedef avx2_u32 avx2;
+    };
+
+    template<>
+    struct lanes<float> {
+        static constexpr bool simd = true;
+        typedef sse2_f32 sse2;
+        typedef avx2_f32 avx2;
+    };
+#else
+    template<typename T>
+    struct lanes {
+        static constexpr bool simd = false;
+    };
+#endif
+
+    inline search_isa detect() noexcept {
+#if VECTOR_SEARCH_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return search_isa::avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return search_isa::sse2;
+        }
+#endif
+        return search_isa::scalar;
+    }
+
+    inline search_isa detected() noexcept {
+        static const search_isa isa = detect();
+        return isa;
+    }
+
+    inline std::atomic<search_isa> &selected() noexcept {
+        static std::atomic<search_isa> isa(detected());
+        return isa;
+    }
+
+    template<typename T>
+    bool is_nan(T const &x) {
+        if constexpr (std::is_floating_point<T>::value) {
+            return x != x;
+        } else {
+            return false;
+        }
+    }
+
+    template<typename T>
+    size_t find_index(T const *p, size_t n, T const &x) {
+#if VECTOR_SEARCH_SIMD
+        if constexpr (lanes<T>::simd) {
+            switch (selected().load(std::memory_order_relaxed)) {
+                case search_isa::avx2:
+                    return avx2::find<typename lanes<T>::avx2>(p, n, x);
+                case search_isa::sse2:
+                    return sse2::find<typename lanes<T>::sse2>(p, n, x);
+                case search_isa::scalar:
+                    break;
+            }
+        }
+#endif
+        return static_cast<size_t>(std::find(p, p + n, x) - p);
+    }
+
+    template<typename T>
+    size_t count(T const *p, size_t n, T const &x) {
+#if VECTOR_SEARCH_SIMD
+        if constexpr (lanes<T>::simd) {
+            switch (selected().load(std::memory_order_relaxed)) {
+                case search_isa::avx2:
+                    return avx2::count<typename lanes<T>::avx2>(p, n, x);
+                case search_isa::sse2:
+                    return sse2::count<typename lanes<T>::sse2>(p, n, x);
+                case search_isa::scalar:
+                    break;
+            }
+        }
+#endif
+        return static_cast<size_t>(std::count(p, p + n, x));
+    }
+
+    // The kernels compute the extreme value, a second scan finds its first
+    // position; a NaN in front makes the scalar algorithms return it.
+    template<typename T>
+    size_t min_index(T const *p, size_t n) {
+#if VECTOR_SEARCH_SIMD
+        if constexpr (lanes<T>::simd) {
+            if (n != 0 && !is_nan(p[0])) {
+                switch (selected().load(std::memory_order_relaxed)) {
+                    case search_isa::avx2:
+                        return find_index(p, n, avx2::min_value<typename lanes<T>::avx2>(p, n));
+                    case search_isa::sse2:
+                        return find_index(p, n, sse2::min_value<typename lanes<T>::sse2>(p, n));
+                    case search_isa::scalar:
+                        break;
+                }
+            }
+        }
+#endif
+        return static_cast<size_t>(std::min_element(p, p + n) - p);
+    }
+
+    template<typename T>
+    size_t max_index(T const *p, size_t n) {
+#if VECTOR_SEARCH_SIMD
+        if constexpr (lanes<T>::simd) {
+            if (n != 0 && !is_nan(p[0])) {
+                switch (selected().load(std::memory_order_relaxed)) {
+                    case search_isa::avx2:
+                        return find_index(p, n, avx2::max_value<typename lanes<T>::avx2>(p, n));
+                    case search_isa::sse2:
+                        return find_index(p, n, sse2::max_value<typename lanes<T>::sse2>(p, n));
+                    case search_isa::scalar:
+                        break;
+                }
+            }
+        }
+#endif
+        return static_cast<size_t>(std::max_element(p, p + n) - p);
+    }
+
+    // Last position of a largest element, like std::minmax_element.
+    template<typename T>
+    size_t last_max_index(T const *p, size_t n) {
+        size_t first = max_index(p, n);
+        if (first == n || is_nan(p[first])) {
+            return first;
+        }
+        size_t i = n;
+        while (--i != first && (p[i] < p[first] || p[first] < p[i] || is_nan(p[i]))) {
+        }
+        return i;
+    }
+}
+
+// Kernel set this CPU supports.
+inline search_isa detected_search_isa() noexcept {
+    return search_detail::detected();
+}
+
+// Kernel set used from now on, capped at detected_search_isa(). Meant for
+// tests and benchmarks that compare the implementations.
+inline void set_search_isa(search_isa isa) noexcept {
+    search_detail::selected().store(std::min(isa, detected_search_isa()));
+}
+
+inline search_isa active_search_isa() noexcept {
+    return search_detail::selected().load();
+}
+
+// The value is converted to the element type, as for std::find, rather than
+// taking part in deducing it.
+template<typename T, typename Policy>
+typename vector<T, Policy>::const_iterator find(vector<T, Policy> const &v,
+                                                typename vector<T, Policy>::value_type const &value) {
+    return v.begin() + search_detail::find_index(v.data(), v.size(), value);
+}
+
+template<typename T, typename Policy>
+size_t count(vector<T, Policy> const &v, typename vector<T, Policy>::value_type const &value) {
+    return search_detail::count(v.data(), v.size(), value);
+}
+
+template<typename T, typename Policy>
+bool contains(vector<T, Policy> const &v, typename vector<T, Policy>::value_type const &value) {
+    return search_detail::find_index(v.data(), v.size(), value) != v.size();
+}
+
+template<typename T, typename Policy>
+typename vector<T, Policy>::const_iterator min_element(vector<T, Policy> const &v) {
+    return v.begin() + search_detail::min_index(v.data(), v.size());
+}
+
+template<typename T, typename Policy>
+typename vector<T, Policy>::const_iterator max_element(vector<T, Policy> const &v) {
+    return v.begin() + search_detail::max_index(v.data(), v.size());
+}
+
+// First smallest and last largest element; (end(), end()) when empty.
+template<typename T, typename Policy>
+std::pair<typename vector<T, Policy>::const_iterator, typename vector<T, Policy>::const_iterator>
+minmax(vector<T, Policy> const &v) {
+    return {min_element(v), v.begin() + search_detail::last_max_index(v.data(), v.size())};
+}
+
+#endif //VECTOR_VECTOR_SEARCH_H
@@ -0,0 +1,93 @@
+// Search kernels over one instruction set, written against a lane traits
+// type V. Deliberately without include guard: vector_search.h includes this
+// file once per instruction set, each time inside its own namespace and, for
+// AVX2, inside a region compiled with that target enabled.
+
+template<typename V>
+size_t find(typename V::value_type const *p, size_t n, typename V::value_type x) {
+    auto key = V::set1(x);
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        int mask = V::eq_mask(V::load(p + i), key);
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+    for (; i != n; ++i) {
+        if (p[i] == x) {
+            return i;
+        }
+    }
+    return n;
+}
+
+// Lane masks have at most 8 bits. Counted through a table: without -mpopcnt
+// __builtin_popcount is a library call, slower than the scalar loop.
+inline size_t mask_bits(int mask) {
+    static constexpr unsigned char nibble[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    return nibble[mask & 15] + nibble[(mask >> 4) & 15];
+}
+
+template<typename V>
+size_t count(typename V::value_type const *p, size_t n, typename V::value_type x) {
+    auto key = V::set1(x);
+    size_t result = 0;
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        result += mask_bits(V::eq_mask(V::load(p + i), key));
+    }
+    for (; i != n; ++i) {
+        result += p[i] == x;
+    }
+    return result;
+}
+
+// Requires n > 0 and p[0] not NaN; NaN elements are skipped.
+template<typename V>
+typename V::value_type min_value(typename V::value_type const *p, size_t n) {
+    typedef typename V::value_type value_type;
+    auto acc = V::set1(p[0]);
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        acc = V::min(V::load(p + i), acc);
+    }
+    value_type lanes[V::width];
+    V::store(lanes, acc);
+    value_type result = lanes[0];
+    for (size_t lane = 1; lane != V::width; ++lane) {
+        if (lanes[lane] < result) {
+            result = lanes[lane];
+        }
+    }
+    for (; i != n; ++i) {
+        if (p[i] < result) {
+            result = p[i];
+        }
+    }
+    return result;
+}
+
+// Requires n > 0 and p[0] not NaN; NaN elements are skipped.
+template<typename V>
+typename V::value_type max_value(typename V::value_type const *p, size_t n) {
+    typedef typename V::value_type value_type;
+    auto acc = V::set1(p[0]);
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        acc = V::max(V::load(p + i), acc);
+    }
+    value_type lanes[V::width];
+    V::store(lanes, acc);
+    value_type result = lanes[0];
+    for (size_t lane = 1; lane != V::width; ++lane) {
+        if (result < lanes[lane]) {
+            result = lanes[lane];
+        }
+    }
+    for (; i != n; ++i) {
+        if (result < p[i]) {
+            result = p[i];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "block_pool.h"
+#include "gtest/gtest.h"
+#include "vector_search.h"
+#include "vector_stats.h"
+
+namespace
+{
+    // Runs f once per kernel set this CPU supports.
+    template <typename F>
+    void for_each_isa(F f)
+    {
+        search_isa original = active_search_isa();
+        for (search_isa isa : {search_isa::scalar, search_isa::sse2, search_isa::avx2})
+        {
+            if (detected_search_isa() < isa)
+                break;
+            set_search_isa(isa);
+            f(isa);
+        }
+        set_search_isa(original);
+    }
+
+    template <typename T>
+    void expect_matches_std(std::vector<T> const& values, std::vector<T> const& probes, bool with_minmax)
+    {
+        // every length up to a few vector widths, then the whole input
+        std::vector<size_t> lengths;
+        for (size_t n = 0; n != 40 && n <= values.size(); ++n)
+            lengths.push_back(n);
+        lengths.push_back(values.size());
+
+        for_each_isa([&](search_isa isa)
+                     {
+                         for (size_t n : lengths)
+                         {
+                             vector<T> v;
+                             for (size_t i = 0; i != n; ++i)
+                                 v.push_back(values[i]);
+                             auto first = values.begin();
+                             auto last = values.begin() + static_cast<std::ptrdiff_t>(n);
+                             SCOPED_TRACE("isa " + std::to_string(static_cast<int>(isa)) + ", n " + std::to_string(n));
+
+                             for (T const& x : probes)
+                             {
+                                 EXPECT_EQ(std::find(first, last, x) - first, find(v, x) - v.begin());
+                                 EXPECT_EQ(static_cast<size_t>(std::count(first, last, x)), count(v, x));
+                                 EXPECT_EQ(std::find(first, last, x) != last, contains(v, x));
+                             }
+                             EXPECT_EQ(std::min_element(first, last) - first, min_element(v) - v.begin());
+                             EXPECT_EQ(std::max_element(first, last) - first, max_element(v) - v.begin());
+                             if (with_minmax)
+                             {
+                                 auto expected = std::minmax_element(first, last);
+                                 auto actual = minmax(v);
+                                 EXPECT_EQ(expected.first - first, actual.first - v.begin());
+                                 EXPECT_EQ(expected.second - first, actual.second - v.begin());
+                             }
+                         }
+                     });
+    }
+}
+
+TEST(vector_search, int32)
+{
+    std::mt19937 rng(1);
+    std::vector<std::int32_t> values;
+    for (size_t i = 0; i != 1000; ++i)
+        values.push_back(static_cast<std::int32_t>(rng() % 64) - 32);
+    values[700] = std::numeric_limits<std::int32_t>::min();
+    values[701] = std::numeric_limits<std::int32_t>::max();
+    expect_matches_std<std::int32_t>(values, {-32, 0, 31, 100, std::numeric_limits<std::int32_t>::min()}, true);
+}
+
+TEST(vector_search, uint32)
+{
+    std::mt19937 rng(2);
+    std::vector<std::uint32_t> values;
+    // straddle the sign bit, where a signed comparison would go wrong
+    for (size_t i = 0; i != 1000; ++i)
+        values.push_back(0x7ffffff0u + rng() % 32);
+    expect_matches_std<std::uint32_t>(values, {0x7ffffff0u, 0x80000000u, 0x8000000fu, 0u}, true);
+}
+
+TEST(vector_search, float)
+{
+    std::mt19937 rng(3);
+    std::vector<float> values;
+    for (size_t i = 0; i != 1000; ++i)
+        values.push_back(static_cast<float>(static_cast<int>(rng() % 200) - 100) / 4);
+    values[5] = -0.0f;
+    values[6] = std::numeric_limits<float>::infinity();
+    values[600] = -std::numeric_limits<float>::infinity();
+    expect_matches_std<float>(values, {0.0f, 1.25f, -std::numeric_limits<float>::infinity(), 1e9f}, true);
+
+    // NaN is never found and is skipped by min and max, unless it comes first
+    values[17] = std::numeric_limits<float>::quiet_NaN();
+    values[900] = std::numeric_limits<float>::quiet_NaN();
+    expect_matches_std<float>(values, {std::numeric_limits<float>::quiet_NaN(), 0.0f}, false);
+    values[0] = std::numeric_limits<float>::quiet_NaN();
+    expect_matches_std<float>(values, {0.0f}, false);
+}
+
+TEST(vector_search, scalar_types)
+{
+    std::mt19937 rng(4);
+    std::vector<std::int64_t> numbers;
+    std::vector<std::string> words;
+    for (size_t i = 0; i != 200; ++i)
+    {
+        numbers.push_back(static_cast<std::int64_t>(rng() % 50));
+        words.push_back(std::to_string(rng() % 50));
+    }
+    expect_matches_std<std::int64_t>(numbers, {0, 7, 49, 50}, true);
+    expect_matches_std<std::string>(words, {"0", "7", "49", "50"}, true);
+}
+
+TEST(vector_search, value_converts_like_std_find)
+{
+    vector<double> d;
+    for (int i = 0; i != 100; ++i)
+        d.push_back(i % 10);
+    EXPECT_EQ(1, find(d, 1) - d.begin());
+    EXPECT_EQ(10u, count(d, 3));
+    EXPECT_FALSE(contains(d, 10));
+
+    vector<float> f;
+    f.push_back(1.5f);
+    f.push_back(1.0f);
+    EXPECT_EQ(1u, count(f, 1.0));
+}
+
+TEST(vector_search, any_policy)
+{
+    vector<int, vector_stats_policy> s;
+    vector<int, pooled_vector_policy> p;
+    for (int i = 0; i != 1000; ++i)
+    {
+        s.push_back(i % 100);
+        p.push_back(i % 100);
+    }
+    EXPECT_EQ(42, find(s, 42) - s.begin());
+    EXPECT_EQ(10u, count(p, 7));
+    EXPECT_TRUE(contains(p, 99));
+    EXPECT_EQ(0, min_element(s) - s.begin());
+    EXPECT_EQ(99, max_element(p) - p.begin());
+    EXPECT_EQ(999, minmax(p).second - p.begin());
+}
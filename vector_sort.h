@@ -0,0 +1,182 @@
+#ifndef VECTOR_VECTOR_SORT_H
+#define VECTOR_VECTOR_SORT_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "vector.h"
+#include "vector_parallel.h"
+#include "work_stealing_pool.h"
+
+// Sorts a vector in place on a work_stealing_pool.
+//
+// The buffer is detached once, through data(), and everything below works on
+// raw pointers. Arithmetic keys under std::less are sorted by a parallel LSD
+// radix sort, or by a branchless sorting network when there are at most
+// sort_detail::network_size of them. Everything else goes through a parallel
+// merge sort: chunks are sorted with std::sort, then merged pairwise in
+// parallel rounds. Like std::sort, the result is not stable.
+
+namespace sort_detail {
+    template<typename T>
+    struct has_radix_key : std::integral_constant<bool,
+            (std::is_integral<T>::value && !std::is_same<T, bool>::value) ||
+            std::is_same<T, float>::value || std::is_same<T, double>::value> {
+    };
+
+    template<typename T, typename Compare>
+    struct radix_sortable : std::integral_constant<bool, has_radix_key<T>::value &&
+            (std::is_same<Compare, std::less<T>>::value || std::is_same<Compare, std::less<>>::value)> {
+    };
+
+    template<typename T, bool = std::is_floating_point<T>::value>
+    struct radix_key_type {
+        typedef typename std::make_unsigned<T>::type type;
+    };
+
+    template<typename T>
+    struct radix_key_type<T, true> {
+        typedef typename std::conditional<sizeof(T) == 4, std::uint32_t, std::uint64_t>::type type;
+    };
+
+    // Maps a key to an unsigned integer with the same order.
+    template<typename T>
+    typename radix_key_type<T>::type to_radix_key(T x) {
+        typedef typename radix_key_type<T>::type key;
+        const key sign = key(1) << (8 * sizeof(T) - 1);
+        if constexpr (std::is_floating_point<T>::value) {
+            key bits;
+            std::memcpy(&bits, &x, sizeof(x));
+            return bits & sign ? ~bits : bits | sign;
+        } else if constexpr (std::is_signed<T>::value) {
+            return static_cast<key>(x) ^ sign;
+        } else {
+            return x;
+        }
+    }
+
+    constexpr size_t network_size = 16;
+    constexpr size_t radix_threshold = 1024;
+
+    // Bitonic network over network_size slots, padded with the largest key.
+    // Every stage is a fixed pattern of min/max pairs without branches, which
+    // the compiler can turn into vector instructions.
+    template<typename T>
+    void network_sort(T *data, size_t n) {
+        T keys[network_size];
+        std::fill(std::copy(data, data + n, keys), keys + network_size,
+                  std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                       : std::numeric_limits<T>::max());
+        for (size_t k = 2; k <= network_size; k *= 2) {
+            for (size_t j = k / 2; j > 0; j /= 2) {
+                for (size_t i = 0; i != network_size; ++i) {
+                    size_t l = i ^ j;
+                    if (l > i) {
+                        T lo = std::min(keys[i], keys[l]);
+                        T hi = std::max(keys[i], keys[l]);
+                        bool ascending = (i & k) == 0;
+                        keys[i] = ascending ? lo : hi;
+                        keys[l] = ascending ? hi : lo;
+                    }
+                }
+            }
+        }
+        std::copy(keys, keys + n, data);
+    }
+
+    // One counting pass per key byte, each split into chunks: the chunks
+    // histogram their byte in parallel, then scatter to disjoint ranges of
+    // the other buffer. Bytes that are equal across all keys are skipped.
+    template<typename T>
+    void radix_sort(T *data, size_t n, work_stealing_pool &pool) {
+        typedef typename radix_key_type<T>::type key;
+        const size_t chunks = parallel_detail::chunk_count(pool, n);
+        vector<T> buffer;
+        buffer.resize(n, T());
+        T *from = data;
+        T *to = buffer.data();
+        std::vector<std::array<size_t, 256>> counts(chunks);
+
+        for (size_t shift = 0; shift != 8 * sizeof(key); shift += 8) {
+            parallel_detail::for_chunks(pool, n, chunks, [&](size_t c, size_t first, size_t last) {
+                auto &count = counts[c];
+                count.fill(0);
+                for (size_t i = first; i != last; ++i) {
+                    count[(to_radix_key(from[i]) >> shift) & 0xff]++;
+                }
+            });
+            size_t offset = 0;
+            bool trivial = false;
+            for (size_t digit = 0; digit != 256; ++digit) {
+                size_t total = 0;
+                for (size_t c = 0; c != chunks; ++c) {
+                    size_t count = counts[c][digit];
+                    counts[c][digit] = offset + total;
+                    total += count;
+                }
+                trivial = trivial || total == n;
+                offset += total;
+            }
+            if (trivial) {
+                continue;
+            }
+            parallel_detail::for_chunks(pool, n, chunks, [&](size_t c, size_t first, size_t last) {
+                auto &position = counts[c];
+                for (size_t i = first; i != last; ++i) {
+                    to[position[(to_radix_key(from[i]) >> shift) & 0xff]++] = from[i];
+                }
+            });
+            std::swap(from, to);
+        }
+        if (from != data) {
+            std::copy(from, from + n, data);
+        }
+    }
+
+    template<typename T, typename Compare>
+    void merge_sort(T *data, size_t n, Compare const &cmp, work_stealing_pool &pool) {
+        size_t chunks = parallel_detail::chunk_count(pool, n);
+        parallel_detail::for_chunks(pool, n, chunks, [&](size_t, size_t first, size_t last) {
+            std::sort(data + first, data + last, cmp);
+        });
+        // after a round with width w, every run of w chunks is sorted
+        for (size_t width = 1; width < chunks; width *= 2) {
+            size_t merges = (chunks + 2 * width - 1) / (2 * width);
+            parallel_detail::for_chunks(pool, merges, merges, [&](size_t, size_t m, size_t) {
+                size_t left = 2 * width * m;
+                size_t middle = std::min(left + width, chunks);
+                size_t right = std::min(left + 2 * width, chunks);
+                std::inplace_merge(data + n * left / chunks, data + n * middle / chunks,
+                                   data + n * right / chunks, cmp);
+            });
+        }
+    }
+}
+
+template<typename T, typename Policy, typename Compare = std::less<T>>
+void vector_sort(vector<T, Policy> &v, Compare cmp = Compare(), work_stealing_pool &pool = default_parallel_pool()) {
+    size_t n = v.size();
+    if (n < 2) {
+        return;
+    }
+    T *data = v.data();
+    if constexpr (sort_detail::radix_sortable<T, Compare>::value) {
+        if (n <= sort_detail::network_size) {
+            sort_detail::network_sort(data, n);
+            return;
+        }
+        if (n >= sort_detail::radix_threshold) {
+            sort_detail::radix_sort(data, n, pool);
+            return;
+        }
+    }
+    sort_detail::merge_sort(data, n, cmp, pool);
+}
+
+#endif //VECTOR_VECTOR_SORT_H
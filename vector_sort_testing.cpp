@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "block_pool.h"
+#include "gtest/gtest.h"
+#include "vector_sort.h"
+#include "vector_stats.h"
+
+namespace
+{
+    template <typename T, typename Generate, typename Compare = std::less<T>>
+    void expect_sorts_like_std(size_t n, Generate generate, Compare cmp = Compare())
+    {
+        work_stealing_pool pool(3);
+        vector<T> v;
+        std::vector<T> expected;
+        for (size_t i = 0; i != n; ++i)
+        {
+            T x = generate(i);
+            v.push_back(x);
+            expected.push_back(x);
+        }
+        vector<T> original = v;
+        vector_sort(v, cmp, pool);
+        std::sort(expected.begin(), expected.end(), cmp);
+
+        ASSERT_EQ(n, v.size());
+        for (size_t i = 0; i != n; ++i)
+            ASSERT_EQ(expected[i], v[i]) << "n = " << n << ", i = " << i;
+        // the copy sharing the buffer keeps the unsorted contents
+        for (size_t i = 0; i != n; ++i)
+            ASSERT_EQ(generate(i), original[i]);
+    }
+
+    // small, network, merge and radix cases
+    const size_t sizes[] = {0, 1, 2, 15, 16, 17, 1000, 1024, 100000};
+}
+
+TEST(vector_sort, uint64)
+{
+    std::mt19937_64 rng(1);
+    std::vector<std::uint64_t> keys;
+    for (size_t i = 0; i != 100000; ++i)
+        keys.push_back(rng());
+    for (size_t n : sizes)
+        expect_sorts_like_std<std::uint64_t>(n, [&](size_t i) { return keys[i]; });
+    // only the low byte varies: the other passes are skipped
+    for (size_t n : sizes)
+        expect_sorts_like_std<std::uint64_t>(n, [&](size_t i) { return keys[i] & 0xff; });
+}
+
+TEST(vector_sort, signed_and_float)
+{
+    std::mt19937 rng(2);
+    std::vector<std::int32_t> ints;
+    std::vector<float> floats;
+    std::vector<double> doubles;
+    std::uniform_real_distribution<double> real(-1e6, 1e6);
+    for (size_t i = 0; i != 100000; ++i)
+    {
+        ints.push_back(static_cast<std::int32_t>(rng()));
+        floats.push_back(static_cast<float>(real(rng)));
+        doubles.push_back(real(rng));
+    }
+    floats[3] = -std::numeric_limits<float>::infinity();
+    doubles[5] = std::numeric_limits<double>::infinity();
+    for (size_t n : sizes)
+    {
+        expect_sorts_like_std<std::int32_t>(n, [&](size_t i) { return ints[i]; });
+        expect_sorts_like_std<float>(n, [&](size_t i) { return floats[i]; });
+        expect_sorts_like_std<double>(n, [&](size_t i) { return doubles[i]; });
+    }
+}
+
+TEST(vector_sort, custom_comparator)
+{
+    std::mt19937 rng(3);
+    std::vector<std::string> words;
+    for (size_t i = 0; i != 100000; ++i)
+        words.push_back(std::to_string(rng() % 50000));
+    for (size_t n : sizes)
+    {
+        expect_sorts_like_std<std::string>(n, [&](size_t i) { return words[i]; });
+        expect_sorts_like_std<std::uint64_t>(n, [&](size_t i) { return std::uint64_t(words[i].size() * 7 + i % 3); },
+                                             std::greater<std::uint64_t>());
+    }
+}
+
+TEST(vector_sort, any_policy)
+{
+    std::mt19937_64 rng(7);
+    vector<std::uint32_t, pooled_vector_policy> radix;
+    vector<std::string, vector_stats_policy> merged;
+    for (int i = 0; i != 100000; ++i)
+    {
+        radix.push_back(static_cast<std::uint32_t>(rng()));
+        if (i % 10 == 0)
+            merged.push_back(std::to_string(rng() % 1000));
+    }
+    vector_sort(radix);
+    vector_sort(merged, std::greater<std::string>());
+    EXPECT_TRUE(std::is_sorted(radix.begin(), radix.end()));
+    EXPECT_TRUE(std::is_sorted(merged.begin(), merged.end(), std::greater<std::string>()));
+}
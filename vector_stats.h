@@ -0,0 +1,194 @@
+#ifndef VECTOR_VECTOR_STATS_H
+#define VECTOR_VECTOR_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+#include "vector.h"
+
+// Counters of vector's copy-on-write traffic, for vectors instantiated with
+// vector_stats_policy:
+//
+//     vector<int, vector_stats_policy> v;
+//     ...
+//     vector_stats s = vector_stats::snapshot();
+//
+// Every thread counts into its own counters, written with plain relaxed
+// stores; snapshot() sums those of all threads, including ones that have
+// exited. Vectors with the default policy count nothing and pay nothing.
+struct vector_stats {
+    // copies that share a heap block instead of copying it
+    size_t shares = 0;
+    // first writes to a shared block, and the bytes of elements they copied
+    size_t detaches = 0;
+    size_t detach_bytes = 0;
+    // moves to a block of another capacity, and the bytes they copied
+    size_t reallocations = 0;
+    size_t reallocation_bytes = 0;
+    // capacity exhausted by push_back or insert
+    size_t growths = 0;
+    // the inline element moved to the heap
+    size_t inline_to_heap = 0;
+    // heap blocks released, and their capacity in bytes
+    size_t frees = 0;
+    size_t freed_bytes = 0;
+
+    // Totals over all threads.
+    static vector_stats snapshot();
+
+    // Counters of the calling thread only.
+    static vector_stats thread_snapshot();
+
+    friend vector_stats operator-(vector_stats a, vector_stats const &b) noexcept {
+        a.shares -= b.shares;
+        a.detaches -= b.detaches;
+        a.detach_bytes -= b.detach_bytes;
+        a.reallocations -= b.reallocations;
+        a.reallocation_bytes -= b.reallocation_bytes;
+        a.growths -= b.growths;
+        a.inline_to_heap -= b.inline_to_heap;
+        a.frees -= b.frees;
+        a.freed_bytes -= b.freed_bytes;
+        return a;
+    }
+};
+
+namespace stats_detail {
+    // Written by the owning thread only; atomic so that snapshot() may read
+    // them from another one.
+    struct counters {
+        std::atomic<size_t> shares{0};
+        std::atomic<size_t> detaches{0};
+        std::atomic<size_t> detach_bytes{0};
+        std::atomic<size_t> reallocations{0};
+        std::atomic<size_t> reallocation_bytes{0};
+        std::atomic<size_t> growths{0};
+        std::atomic<size_t> inline_to_heap{0};
+        std::atomic<size_t> frees{0};
+        std::atomic<size_t> freed_bytes{0};
+
+        vector_stats load() const noexcept {
+            vector_stats s;
+            s.shares = shares.load(std::memory_order_relaxed);
+            s.detaches = detaches.load(std::memory_order_relaxed);
+            s.detach_bytes = detach_bytes.load(std::memory_order_relaxed);
+            s.reallocations = reallocations.load(std::memory_order_relaxed);
+            s.reallocation_bytes = reallocation_bytes.load(std::memory_order_relaxed);
+            s.growths = growths.load(std::memory_order_relaxed);
+            s.inline_to_heap = inline_to_heap.load(std::memory_order_relaxed);
+            s.frees = frees.load(std::memory_order_relaxed);
+            s.freed_bytes = freed_bytes.load(std::memory_order_relaxed);
+            return s;
+        }
+    };
+
+    inline void add(std::atomic<size_t> &counter, size_t n) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    inline void accumulate(vector_stats &total, vector_stats const &s) noexcept {
+        total.shares += s.shares;
+        total.detaches += s.detaches;
+        total.detach_bytes += s.detach_bytes;
+        total.reallocations += s.reallocations;
+        total.reallocation_bytes += s.reallocation_bytes;
+        total.growths += s.growths;
+        total.inline_to_heap += s.inline_to_heap;
+        total.frees += s.frees;
+        total.freed_bytes += s.freed_bytes;
+    }
+
+    struct thread_counters;
+
+    // The counters of live threads, linked without allocating, and the
+    // totals of exited ones.
+    struct registry {
+        std::mutex mutex;
+        thread_counters *threads = nullptr;
+        vector_stats exited;
+
+        static registry &instance() {
+            static registry r;
+            return r;
+        }
+    };
+
+    struct thread_counters : counters {
+        thread_counters *prev = nullptr;
+        thread_counters *next = nullptr;
+
+        thread_counters() noexcept {
+            registry &r = registry::instance();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            next = r.threads;
+            if (next != nullptr) {
+                next->prev = this;
+            }
+            r.threads = this;
+        }
+
+        ~thread_counters() {
+            registry &r = registry::instance();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            accumulate(r.exited, load());
+            (prev != nullptr ? prev->next : r.threads) = next;
+            if (next != nullptr) {
+                next->prev = prev;
+            }
+        }
+    };
+
+    inline counters &local() {
+        thread_local thread_counters c;
+        return c;
+    }
+}
+
+inline vector_stats vector_stats::snapshot() {
+    stats_detail::registry &r = stats_detail::registry::instance();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    vector_stats total = r.exited;
+    for (auto *c = r.threads; c != nullptr; c = c->next) {
+        stats_detail::accumulate(total, c->load());
+    }
+    return total;
+}
+
+inline vector_stats vector_stats::thread_snapshot() {
+    return stats_detail::local().load();
+}
+
+struct vector_stats_policy : default_vector_policy {
+    static void on_share(size_t) noexcept {
+        stats_detail::add(stats_detail::local().shares, 1);
+    }
+
+    static void on_detach(size_t, size_t copied) noexcept {
+        auto &c = stats_detail::local();
+        stats_detail::add(c.detaches, 1);
+        stats_detail::add(c.detach_bytes, copied);
+    }
+
+    static void on_reallocate(size_t, size_t, size_t copied) noexcept {
+        auto &c = stats_detail::local();
+        stats_detail::add(c.reallocations, 1);
+        stats_detail::add(c.reallocation_bytes, copied);
+    }
+
+    static void on_grow(size_t, size_t) noexcept {
+        stats_detail::add(stats_detail::local().growths, 1);
+    }
+
+    static void on_inline_to_heap(size_t) noexcept {
+        stats_detail::add(stats_detail::local().inline_to_heap, 1);
+    }
+
+    static void on_free(size_t capacity) noexcept {
+        auto &c = stats_detail::local();
+        stats_detail::add(c.frees, 1);
+        stats_detail::add(c.freed_bytes, capacity);
+    }
+};
+
+#endif //VECTOR_VECTOR_STATS_H
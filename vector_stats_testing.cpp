@@ -0,0 +1,88 @@
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "vector_stats.h"
+
+typedef vector<int, vector_stats_policy> stats_vector;
+
+namespace
+{
+    // Counters of the calling thread since construction.
+    struct stats_meter
+    {
+        vector_stats operator()() const
+        {
+            return vector_stats::thread_snapshot() - start;
+        }
+
+    private:
+        vector_stats start = vector_stats::thread_snapshot();
+    };
+}
+
+TEST(vector_stats, default_policy_is_free)
+{
+    EXPECT_EQ(sizeof(vector<int>), sizeof(stats_vector));
+    EXPECT_TRUE(std::is_empty<default_vector_policy>::value);
+}
+
+TEST(vector_stats, growth)
+{
+    stats_meter m;
+    {
+        stats_vector v;
+        for (int i = 0; i != 100; ++i)
+            v.push_back(i);
+        // 1 inline, then capacities 2, 4, ..., 128
+        EXPECT_EQ(1u, m().inline_to_heap);
+        EXPECT_EQ(7u, m().growths);
+        EXPECT_EQ(6u, m().reallocations);
+        EXPECT_EQ((2 + 4 + 8 + 16 + 32 + 64) * sizeof(int), m().reallocation_bytes);
+        EXPECT_EQ(6u, m().frees);
+
+        v.reserve(1000);
+        EXPECT_EQ(7u, m().reallocations);
+        EXPECT_EQ(7u, m().growths);
+    }
+    EXPECT_EQ(8u, m().frees);
+    EXPECT_EQ((2 + 4 + 8 + 16 + 32 + 64 + 128 + 1000) * sizeof(int), m().freed_bytes);
+}
+
+TEST(vector_stats, share_and_detach)
+{
+    stats_vector v;
+    for (int i = 0; i != 10; ++i)
+        v.push_back(i);
+
+    stats_meter m;
+    stats_vector a = v;
+    stats_vector b;
+    b = v;
+    EXPECT_EQ(2u, m().shares);
+    EXPECT_EQ(0u, m().detaches);
+
+    a[0] = 1;
+    b.push_back(10);
+    EXPECT_EQ(2u, m().detaches);
+    EXPECT_EQ(20 * sizeof(int), m().detach_bytes);
+    EXPECT_EQ(0u, m().frees);
+
+    v = stats_vector();
+    EXPECT_EQ(1u, m().frees);
+}
+
+TEST(vector_stats, snapshot_includes_other_threads)
+{
+    vector_stats before = vector_stats::snapshot();
+    std::thread t([]
+                  {
+                      stats_vector v;
+                      v.push_back(1);
+                      stats_vector w = v;
+                      w.push_back(2);
+                  });
+    t.join();
+    vector_stats delta = vector_stats::snapshot() - before;
+    EXPECT_EQ(1u, delta.inline_to_heap);
+    EXPECT_EQ(1u, delta.frees);
+}
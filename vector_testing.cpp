@@ -1,11 +1,64 @@
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
 #include "gtest/gtest.h"
 #include "fault_injection.h"
 #include "counted.h"
+#include "alloc_stats.h"
 #include "vector.h"
+#include "work_stealing_pool.h"
 
 typedef vector<counted> container;
 typedef vector<int> container_int;
 
+namespace
+{
+    // Element copies and heap allocations performed since construction.
+    struct cost_meter
+    {
+        cost_meter()
+            : copy_constructions(counted::copy_constructions)
+            , copy_assignments(counted::copy_assignments)
+            , destructions(counted::destructions)
+        {}
+
+        size_t copies() const
+        {
+            return counted::copy_constructions - copy_constructions
+                 + counted::copy_assignments - copy_assignments;
+        }
+
+        size_t destroyed() const
+        {
+            return counted::destructions - destructions;
+        }
+
+        size_t allocations() const
+        {
+            return alloc.stats().allocations;
+        }
+
+    private:
+        alloc_stats_scope alloc;
+        size_t copy_constructions;
+        size_t copy_assignments;
+        size_t destructions;
+    };
+
+    container filled(int n, size_t cap = 0)
+    {
+        container c;
+        c.reserve(cap);
+        for (int i = 0; i != n; ++i)
+            c.push_back(i);
+        return c;
+    }
+}
+
 TEST(correctness, default_ctor)
 {
     faulty_run([]
@@ -972,6 +1025,379 @@ TEST(correctness, swap_non_empty_non_empty)
                });
 }
 
+TEST(correctness, mutable_access_detaches)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   container c;
+                   for (int i = 0; i != 5; ++i)
+                       c.push_back(i);
+                   container c2 = c;
+                   c2.data()[0] = 10;
+                   *(c2.begin() + 1) = 11;
+                   c2.back() = 14;
+                   container c3 = c;
+                   c3.front() = 20;
+                   container c4 = c;
+                   c4.pop_back();
+                   c4.pop_back();
+                   for (int i = 0; i != 5; ++i)
+                       EXPECT_EQ(i, c[i]);
+                   ASSERT_EQ(3u, c4.size());
+                   EXPECT_EQ(2, c4.back());
+                   EXPECT_EQ(10, c2[0]);
+                   EXPECT_EQ(11, c2[1]);
+                   EXPECT_EQ(14, c2[4]);
+                   EXPECT_EQ(20, c3[0]);
+               });
+}
+
+TEST(correctness, erase_shared_by_const_iterator)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   container c;
+                   for (int i = 0; i != 5; ++i)
+                       c.push_back(i);
+                   container c2 = c;
+                   container const& view = c2;
+                   c2.erase(view.begin() + 1, view.begin() + 3);
+                   c2.erase(view.end() - 1);
+                   EXPECT_EQ(5u, c.size());
+                   for (int i = 0; i != 5; ++i)
+                       EXPECT_EQ(i, c[i]);
+                   ASSERT_EQ(2u, c2.size());
+                   EXPECT_EQ(0, c2[0]);
+                   EXPECT_EQ(3, c2[1]);
+               });
+}
+
+TEST(allocations, copy_of_shared)
+{
+    container_int c;
+    for (int i = 0; i != 10; ++i)
+        c.push_back(i);
+    container_int d = c;
+
+    alloc_stats_scope s;
+    container_int e = d;
+    container_int f;
+    f = c;
+    EXPECT_EQ(0u, s.stats().allocations);
+}
+
+TEST(allocations, push_back_growth)
+{
+    alloc_stats_scope s;
+    {
+        container_int c;
+        for (int i = 0; i != 1000; ++i)
+            c.push_back(i);
+        EXPECT_LE(s.stats().allocations, 11u);
+        EXPECT_GE(s.stats().peak_live_bytes, static_cast<std::ptrdiff_t>(1000 * sizeof(int)));
+    }
+    EXPECT_EQ(s.stats().allocations, s.stats().deallocations);
+    EXPECT_EQ(0, s.stats().live_bytes);
+}
+
+TEST(performance, copy_ctor)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(10);
+    cost_meter m;
+    container d = c;
+    EXPECT_EQ(0u, m.copies());
+    EXPECT_EQ(0u, m.allocations());
+}
+
+TEST(performance, assignment)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(10);
+    container d = filled(5);
+    cost_meter m;
+    d = c;
+    EXPECT_EQ(0u, m.copies());
+    EXPECT_EQ(0u, m.allocations());
+    EXPECT_EQ(5u, m.destroyed());
+}
+
+TEST(performance, first_write_after_share)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(10);
+    container d = c;
+    {
+        cost_meter m;
+        d[0] = 42;
+        EXPECT_EQ(11u, m.copies());
+        EXPECT_EQ(1u, m.allocations());
+    }
+    {
+        cost_meter m;
+        d[1] = 43;
+        EXPECT_EQ(1u, m.copies());
+        EXPECT_EQ(0u, m.allocations());
+    }
+    EXPECT_EQ(0, c[0]);
+}
+
+TEST(performance, push_back_growth)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    cost_meter m;
+    for (int i = 0; i != 1000; ++i)
+        c.push_back(i);
+    EXPECT_LE(m.allocations(), 10u);
+    EXPECT_LE(m.copies(), 2024u);
+}
+
+TEST(performance, push_back_reserved)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    c.reserve(1000);
+    cost_meter m;
+    for (int i = 0; i != 1000; ++i)
+        c.push_back(i);
+    EXPECT_EQ(0u, m.allocations());
+    EXPECT_EQ(1000u, m.copies());
+}
+
+TEST(performance, insert_positions)
+{
+    counted::no_new_instances_guard g;
+    for (int pos : {0, 5, 9, 10})
+    {
+        container c = filled(10, 20);
+        cost_meter m;
+        c.insert(c.begin() + pos, 42);
+        EXPECT_EQ(0u, m.allocations());
+        EXPECT_EQ(static_cast<size_t>(10 - pos + 1), m.copies());
+        EXPECT_EQ(42, c[pos]);
+    }
+}
+
+TEST(performance, insert_full)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(8);
+    cost_meter m;
+    c.insert(c.begin() + 3, 42);
+    EXPECT_EQ(1u, m.allocations());
+    EXPECT_EQ(9u, m.copies());
+}
+
+TEST(performance, insert_shared)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(10, 20);
+    container d = c;
+    cost_meter m;
+    // a mutable iterator would detach d before the insert
+    d.insert(std::as_const(d).begin() + 3, 42);
+    EXPECT_EQ(1u, m.allocations());
+    EXPECT_EQ(11u, m.copies());
+    EXPECT_EQ(10u, c.size());
+}
+
+TEST(performance, erase_positions)
+{
+    counted::no_new_instances_guard g;
+    for (int pos : {0, 5, 9})
+    {
+        container c = filled(10);
+        cost_meter m;
+        c.erase(c.begin() + pos);
+        EXPECT_EQ(0u, m.allocations());
+        EXPECT_EQ(static_cast<size_t>(10 - pos - 1), m.copies());
+    }
+}
+
+TEST(performance, resize)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(10, 20);
+    {
+        cost_meter m;
+        c.resize(15, 1);
+        EXPECT_EQ(0u, m.allocations());
+        EXPECT_EQ(5u, m.copies());
+    }
+    {
+        cost_meter m;
+        c.resize(5, 1);
+        EXPECT_EQ(0u, m.allocations());
+        EXPECT_EQ(0u, m.copies());
+        EXPECT_EQ(10u + 1u, m.destroyed()); // and the by-value argument
+    }
+    EXPECT_EQ(20u, c.capacity());
+}
+
+TEST(performance, reserve_shared)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(10);
+    container d = c;
+    cost_meter m;
+    d.reserve(100);
+    EXPECT_EQ(1u, m.allocations());
+    EXPECT_EQ(10u, m.copies());
+}
+
+TEST(performance, swap)
+{
+    counted::no_new_instances_guard g;
+    container c = filled(10);
+    container d = filled(3);
+    cost_meter m;
+    swap(c, d);
+    EXPECT_EQ(0u, m.copies());
+    EXPECT_EQ(0u, m.allocations());
+}
+
+TEST(fault_injection, filters)
+{
+    auto body = [](std::atomic<size_t>& runs)
+    {
+        return [&runs]
+        {
+            ++runs;
+            counted::no_new_instances_guard g;
+            container c;
+            for (int i = 0; i != 20; ++i)
+                c.push_back(i);
+        };
+    };
+
+    std::atomic<size_t> all(0), large(0), copies(0);
+    faulty_run(body(all));
+    faulty_run(body(large), fault_filter::allocations_of_at_least(16 * sizeof(counted)));
+    faulty_run(body(copies), fault_filter::only_sites({counted::copy_site}));
+
+    // blocks of capacity 16 and 32: two faulty runs and a clean one
+    EXPECT_EQ(3u, large.load());
+    EXPECT_LT(copies.load(), all.load());
+    EXPECT_LT(1u, copies.load());
+}
+
+TEST(fault_injection, replay)
+{
+    std::mutex m;
+    std::string schedule;
+    size_t size_at_fault = 0;
+    auto body = [&](bool record)
+    {
+        counted::no_new_instances_guard g;
+        container c;
+        try
+        {
+            for (int i = 0; i != 10; ++i)
+                c.push_back(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (record && schedule.empty() && c.size() == 7)
+                schedule = current_fault_schedule();
+            else if (!record)
+                size_at_fault = c.size();
+            throw;
+        }
+    };
+
+    faulty_run([&] { body(true); });
+    ASSERT_FALSE(schedule.empty());
+    faulty_run_replay([&] { body(false); }, schedule);
+    EXPECT_EQ(7u, size_at_fault);
+}
+
+namespace
+{
+    // Injection points nested like a call tree. Unwinding passes through
+    // more of them, so a run can inject several faults.
+    void nested_points(int depth)
+    {
+        fault_injection_point();
+        if (depth != 0)
+        {
+            try
+            {
+                nested_points(depth - 1);
+                nested_points(depth - 1);
+            }
+            catch (...)
+            {
+                fault_injection_point();
+                throw;
+            }
+        }
+        fault_injection_point();
+    }
+}
+
+TEST(fault_injection, parallel_matches_serial)
+{
+    auto explore = [](size_t threads, std::multiset<std::string>& schedules)
+    {
+        std::mutex m;
+        auto record = [&]
+        {
+            std::lock_guard<std::mutex> lock(m);
+            schedules.insert(current_fault_schedule());
+        };
+        fault_filter points;
+        points.allocations = false;
+        parallel_faulty_run([&]
+                            {
+                                try
+                                {
+                                    nested_points(3);
+                                }
+                                catch (...)
+                                {
+                                    record();
+                                    throw;
+                                }
+                                record();
+                            }, threads, points);
+    };
+
+    std::multiset<std::string> serial, parallel;
+    explore(1, serial);
+    explore(4, parallel);
+
+    EXPECT_EQ(std::set<std::string>(serial.begin(), serial.end()).size(), serial.size());
+    EXPECT_LT(31u, serial.size());
+    // the first point at depth 0, then the handler of each enclosing level
+    EXPECT_EQ(1u, serial.count("3,0,0,0"));
+    EXPECT_EQ(serial, parallel);
+}
+
+TEST(fault_injection, work_stealing_pool_runs_nested_tasks)
+{
+    std::atomic<size_t> done(0);
+    work_stealing_pool pool(3);
+    EXPECT_EQ(3u, pool.size());
+    for (int i = 0; i != 8; ++i)
+        pool.submit([&]
+                    {
+                        for (int k = 0; k != 8; ++k)
+                            pool.submit([&] { done++; });
+                        done++;
+                    });
+    pool.wait();
+    EXPECT_EQ(72u, done.load());
+
+    pool.submit([] { throw injected_fault("task"); });
+    pool.submit([&] { done++; });
+    EXPECT_THROW(pool.wait(), injected_fault);
+    EXPECT_EQ(73u, done.load());
+}
+
 TEST(exceptions, nothrow_default_ctor)
 {
     faulty_run([]
@@ -1002,6 +1428,33 @@ TEST(exceptions, nothrow_subscript)
                });
 }
 
+TEST(exceptions, insert_end_keeps_contents)
+{
+    faulty_run([]
+               {
+                   counted::no_new_instances_guard g;
+                   container c;
+                   {
+                       fault_injection_disable dg;
+                       for (int i = 0; i != 4; ++i)
+                           c.push_back(i);
+                   }
+                   try
+                   {
+                       c.insert(c.end(), 42);
+                   }
+                   catch (...)
+                   {
+                       EXPECT_EQ(4u, c.size());
+                       for (int i = 0; i != 4; ++i)
+                           EXPECT_EQ(i, c[i]);
+                       throw;
+                   }
+                   EXPECT_EQ(5u, c.size());
+                   EXPECT_EQ(42, c[4]);
+               });
+}
+
 TEST(exceptions, reserve)
 {
     faulty_run([]
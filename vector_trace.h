@@ -0,0 +1,297 @@
+#ifndef VECTOR_VECTOR_TRACE_H
+#define VECTOR_VECTOR_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "vector.h"
+
+// Timeline of the reallocations, detaches and large frees of vectors
+// instantiated with vector_trace_policy:
+//
+//     vector<int, vector_trace_policy> v;
+//     {
+//         vector_trace_tag tag("load_index");
+//         ...
+//     }
+//     vector_trace::write_json(out);
+//
+// Each thread records into its own ring buffer of the last
+// vector_trace::ring_size events, without locks: a slot is guarded by its
+// own sequence number, so a reader on another thread skips slots that are
+// being overwritten. write_json() prints the events in Chrome's trace_event
+// format (chrome://tracing, Perfetto). Timestamps are steady_clock, so they
+// line up with other traces of the same process taken from that clock.
+//
+// A tag is the innermost vector_trace_tag alive on the recording thread; it
+// must point to a string that outlives the trace, such as a literal.
+struct vector_trace_event {
+    enum kind_t : uint8_t {
+        reallocate,
+        detach,
+        free,
+    };
+
+    kind_t kind;
+    // small number given to each thread on its first event
+    uint32_t thread;
+    // steady_clock, nanoseconds
+    uint64_t time;
+    // in bytes, as for vector's policy hooks; equal but for reallocate
+    size_t old_capacity;
+    size_t new_capacity;
+    size_t copied;
+    char const *tag;
+};
+
+namespace trace_detail {
+    inline std::atomic<size_t> free_threshold{64 * 1024};
+
+    inline char const *&current_tag() noexcept {
+        thread_local char const *tag = nullptr;
+        return tag;
+    }
+
+    struct slot {
+        // 2i + 1 while event i is being written, 2i + 2 once it is complete
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint8_t> kind{0};
+        std::atomic<uint32_t> thread{0};
+        std::atomic<uint64_t> time{0};
+        std::atomic<size_t> old_capacity{0};
+        std::atomic<size_t> new_capacity{0};
+        std::atomic<size_t> copied{0};
+        std::atomic<char const *> tag{nullptr};
+    };
+
+    constexpr size_t ring_size = 4096;
+
+    // Written by one thread at a time. A buffer outlives its thread, so that
+    // the events stay in the trace; the next thread to start reuses it.
+    struct ring {
+        slot slots[ring_size];
+        // events written so far
+        std::atomic<uint64_t> head{0};
+        // events before this one were cleared; guarded by the registry mutex
+        uint64_t start = 0;
+        // the owner's number and whether there is one; set under the mutex
+        uint32_t thread = 0;
+        bool in_use = false;
+        ring *next = nullptr;
+
+        void push(vector_trace_event::kind_t kind, size_t old_capacity, size_t new_capacity,
+                  size_t copied) noexcept {
+            uint64_t i = head.load(std::memory_order_relaxed);
+            slot &s = slots[i % ring_size];
+            s.sequence.store(2 * i + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.kind.store(kind, std::memory_order_relaxed);
+            s.thread.store(thread, std::memory_order_relaxed);
+            s.time.store(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count()), std::memory_order_relaxed);
+            s.old_capacity.store(old_capacity, std::memory_order_relaxed);
+            s.new_capacity.store(new_capacity, std::memory_order_relaxed);
+            s.copied.store(copied, std::memory_order_relaxed);
+            s.tag.store(current_tag(), std::memory_order_relaxed);
+            s.sequence.store(2 * i + 2, std::memory_order_release);
+            head.store(i + 1, std::memory_order_release);
+        }
+
+        // Appends the complete events still in the buffer.
+        void read(std::vector<vector_trace_event> &out) const {
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t first = std::max(start, end > ring_size ? end - ring_size : 0);
+            for (uint64_t i = first; i < end; ++i) {
+                slot const &s = slots[i % ring_size];
+                uint64_t before = s.sequence.load(std::memory_order_acquire);
+                vector_trace_event e;
+                e.kind = static_cast<vector_trace_event::kind_t>(s.kind.load(std::memory_order_relaxed));
+                e.thread = s.thread.load(std::memory_order_relaxed);
+                e.time = s.time.load(std::memory_order_relaxed);
+                e.old_capacity = s.old_capacity.load(std::memory_order_relaxed);
+                e.new_capacity = s.new_capacity.load(std::memory_order_relaxed);
+                e.copied = s.copied.load(std::memory_order_relaxed);
+                e.tag = s.tag.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (before == 2 * i + 2 && s.sequence.load(std::memory_order_relaxed) == before) {
+                    out.push_back(e);
+                }
+            }
+        }
+    };
+
+    struct registry {
+        std::mutex mutex;
+        ring *rings = nullptr;
+        uint32_t threads = 0;
+
+        static registry &instance() {
+            static registry r;
+            return r;
+        }
+
+        ~registry() {
+            while (rings != nullptr) {
+                delete std::exchange(rings, rings->next);
+            }
+        }
+
+        // A free buffer, or a new one; nullptr if that cannot be allocated,
+        // and the thread then records nothing.
+        ring *acquire() noexcept {
+            std::lock_guard<std::mutex> lock(mutex);
+            ring *r = rings;
+            while (r != nullptr && r->in_use) {
+                r = r->next;
+            }
+            if (r == nullptr) {
+                r = new(std::nothrow) ring;
+                if (r == nullptr) {
+                    return nullptr;
+                }
+                r->next = rings;
+                rings = r;
+            }
+            // earlier events keep the number of the thread that wrote them
+            r->thread = ++threads;
+            r->in_use = true;
+            return r;
+        }
+
+        void release(ring *r) noexcept {
+            std::lock_guard<std::mutex> lock(mutex);
+            r->in_use = false;
+        }
+    };
+
+    struct thread_ring {
+        ring *r = registry::instance().acquire();
+
+        ~thread_ring() {
+            if (r != nullptr) {
+                registry::instance().release(r);
+            }
+        }
+    };
+
+    inline void record(vector_trace_event::kind_t kind, size_t old_capacity, size_t new_capacity,
+                       size_t copied) noexcept {
+        thread_local thread_ring local;
+        if (local.r != nullptr) {
+            local.r->push(kind, old_capacity, new_capacity, copied);
+        }
+    }
+
+    inline void write_string(std::ostream &out, char const *s) {
+        out << '"';
+        for (; *s != '\0'; ++s) {
+            if (*s == '"' || *s == '\\') {
+                out << '\\' << *s;
+            } else if (static_cast<unsigned char>(*s) >= 0x20) {
+                out << *s;
+            }
+        }
+        out << '"';
+    }
+}
+
+class vector_trace_tag {
+public:
+    explicit vector_trace_tag(char const *tag) noexcept : previous(trace_detail::current_tag()) {
+        trace_detail::current_tag() = tag;
+    }
+
+    vector_trace_tag(vector_trace_tag const &) = delete;
+    vector_trace_tag &operator=(vector_trace_tag const &) = delete;
+
+    ~vector_trace_tag() {
+        trace_detail::current_tag() = previous;
+    }
+
+private:
+    char const *previous;
+};
+
+struct vector_trace {
+    static constexpr size_t ring_size = trace_detail::ring_size;
+
+    // Frees of blocks smaller than this many bytes are not recorded.
+    static void set_free_threshold(size_t bytes) noexcept {
+        trace_detail::free_threshold.store(bytes, std::memory_order_relaxed);
+    }
+
+    // The events of all threads, oldest first. Events recorded while this
+    // runs may or may not be included.
+    static std::vector<vector_trace_event> collect() {
+        std::vector<vector_trace_event> events;
+        trace_detail::registry &r = trace_detail::registry::instance();
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (auto *p = r.rings; p != nullptr; p = p->next) {
+                p->read(events);
+            }
+        }
+        std::stable_sort(events.begin(), events.end(), [](auto const &a, auto const &b) {
+            return a.time < b.time;
+        });
+        return events;
+    }
+
+    // Drops the events recorded so far.
+    static void clear() {
+        trace_detail::registry &r = trace_detail::registry::instance();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto *p = r.rings; p != nullptr; p = p->next) {
+            p->start = p->head.load(std::memory_order_acquire);
+        }
+    }
+
+    // collect() as a trace_event JSON object of instant events.
+    static void write_json(std::ostream &out) {
+        static char const *const names[] = {"reallocate", "detach", "free"};
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for (auto const &e : collect()) {
+            out << (first ? "\n" : ",\n")
+                << "{\"name\":\"" << names[e.kind] << "\",\"cat\":\"vector\",\"ph\":\"i\",\"s\":\"t\""
+                << ",\"ts\":" << e.time / 1000 << '.' << (e.time % 1000) / 100 << (e.time % 100) / 10 << e.time % 10
+                << ",\"pid\":1,\"tid\":" << e.thread
+                << ",\"args\":{\"old_capacity\":" << e.old_capacity
+                << ",\"new_capacity\":" << e.new_capacity
+                << ",\"bytes_copied\":" << e.copied;
+            if (e.tag != nullptr) {
+                out << ",\"tag\":";
+                trace_detail::write_string(out, e.tag);
+            }
+            out << "}}";
+            first = false;
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+};
+
+struct vector_trace_policy : default_vector_policy {
+    static void on_detach(size_t capacity, size_t copied) noexcept {
+        trace_detail::record(vector_trace_event::detach, capacity, capacity, copied);
+    }
+
+    static void on_reallocate(size_t old_capacity, size_t new_capacity, size_t copied) noexcept {
+        trace_detail::record(vector_trace_event::reallocate, old_capacity, new_capacity, copied);
+    }
+
+    static void on_free(size_t capacity) noexcept {
+        if (capacity >= trace_detail::free_threshold.load(std::memory_order_relaxed)) {
+            trace_detail::record(vector_trace_event::free, capacity, capacity, 0);
+        }
+    }
+};
+
+#endif //VECTOR_VECTOR_TRACE_H
@@ -0,0 +1,106 @@
+#include <sstream>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "vector_trace.h"
+
+typedef vector<int, vector_trace_policy> traced_vector;
+
+TEST(vector_trace, reallocate_and_detach)
+{
+    vector_trace::clear();
+    traced_vector v;
+    v.push_back(1);
+    v.push_back(2);
+    {
+        vector_trace_tag tag("grow");
+        v.push_back(3);
+    }
+    traced_vector copy = v;
+    v[0] = 4;
+
+    auto events = vector_trace::collect();
+    ASSERT_EQ(2u, events.size());
+
+    EXPECT_EQ(vector_trace_event::reallocate, events[0].kind);
+    EXPECT_EQ(2 * sizeof(int), events[0].old_capacity);
+    EXPECT_EQ(4 * sizeof(int), events[0].new_capacity);
+    EXPECT_EQ(2 * sizeof(int), events[0].copied);
+    EXPECT_STREQ("grow", events[0].tag);
+
+    EXPECT_EQ(vector_trace_event::detach, events[1].kind);
+    EXPECT_EQ(3 * sizeof(int), events[1].copied);
+    EXPECT_EQ(nullptr, events[1].tag);
+    EXPECT_LE(events[0].time, events[1].time);
+    EXPECT_EQ(events[0].thread, events[1].thread);
+}
+
+TEST(vector_trace, large_frees_only)
+{
+    vector_trace::clear();
+    {
+        traced_vector small;
+        small.reserve(10);
+        traced_vector large;
+        large.reserve(1 << 20);
+    }
+    auto events = vector_trace::collect();
+    // the first reserve of an empty vector only allocates
+    ASSERT_EQ(1u, events.size());
+    EXPECT_EQ(vector_trace_event::free, events[0].kind);
+    EXPECT_EQ((1u << 20) * sizeof(int), events[0].old_capacity);
+
+    vector_trace::set_free_threshold(0);
+    vector_trace::clear();
+    {
+        traced_vector small;
+        small.reserve(10);
+    }
+    vector_trace::set_free_threshold(64 * 1024);
+    EXPECT_EQ(1u, vector_trace::collect().size());
+}
+
+TEST(vector_trace, ring_keeps_latest)
+{
+    vector_trace::clear();
+    traced_vector v;
+    v.reserve(2);
+    for (size_t i = 0; i != vector_trace::ring_size + 10; ++i) {
+        traced_vector copy = v;
+        v.push_back(0);
+        v.pop_back();
+    }
+    auto events = vector_trace::collect();
+    ASSERT_EQ(vector_trace::ring_size, events.size());
+    for (auto const &e : events) {
+        EXPECT_EQ(vector_trace_event::detach, e.kind);
+    }
+}
+
+TEST(vector_trace, threads)
+{
+    vector_trace::clear();
+    traced_vector v;
+    v.reserve(2);
+    std::thread t([]
+                  {
+                      vector_trace_tag tag("worker \"1\"");
+                      traced_vector w;
+                      w.reserve(2);
+                      w.reserve(4);
+                  });
+    t.join();
+    v.reserve(4);
+
+    auto events = vector_trace::collect();
+    ASSERT_EQ(2u, events.size());
+    EXPECT_NE(events[0].thread, events[1].thread);
+
+    std::ostringstream out;
+    vector_trace::write_json(out);
+    std::string json = out.str();
+    EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"reallocate\""));
+    EXPECT_NE(std::string::npos, json.find("\"tag\":\"worker \\\"1\\\"\""));
+    EXPECT_NE(std::string::npos, json.find("\"bytes_copied\":0"));
+}
@@ -0,0 +1,133 @@
+#ifndef VECTOR_VERSIONED_VECTOR_H
+#define VECTOR_VERSIONED_VECTOR_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "epoch_domain.h"
+#include "sharded_refcount.h"
+#include "vector.h"
+
+// Read-mostly vector with snapshot isolation.
+//
+// The current contents live in an immutable version. load() returns a
+// snapshot handle to it without taking a lock; update(fn) lets fn modify a
+// private copy under the writer mutex and then publishes it with one atomic
+// store. A version is freed when the versioned_vector and every snapshot
+// have dropped it.
+//
+// Each version is reference counted with a sharded_refcount: loading and
+// dropping snapshots of the current version only touches the calling
+// thread's shard. load() finds the current version inside an epoch guard,
+// and update() releases the owner reference of the version it replaced
+// only after a grace period, so a retired version is never resurrected.
+//
+// The vector inside a version is never shared with another block: copies of
+// it would touch its non-atomic refcount from several threads. Copy the
+// snapshot handle instead, or build a new vector from its iterators.
+template<typename T>
+class versioned_vector {
+    struct version {
+        version() = default;
+
+        // Copies the elements into a block of its own.
+        explicit version(vector<T> const &from) {
+            if (!from.empty()) {
+                data = vector<T>(from.begin(), from.end());
+            }
+        }
+
+        vector<T> data;
+        sharded_refcount references;
+    };
+
+public:
+    class snapshot {
+    public:
+        snapshot() noexcept = default;
+
+        snapshot(snapshot const &other) noexcept: v(other.v) {
+            if (v != nullptr) {
+                v->references.acquire();
+            }
+        }
+
+        snapshot &operator=(snapshot other) noexcept {
+            std::swap(v, other.v);
+            return *this;
+        }
+
+        ~snapshot() {
+            if (v != nullptr && v->references.release()) {
+                delete v;
+            }
+        }
+
+        vector<T> const &operator*() const noexcept {
+            return v->data;
+        }
+
+        vector<T> const *operator->() const noexcept {
+            return &v->data;
+        }
+
+        explicit operator bool() const noexcept {
+            return v != nullptr;
+        }
+
+    private:
+        friend class versioned_vector;
+
+        explicit snapshot(version *v) noexcept: v(v) {}
+
+        version *v = nullptr;
+    };
+
+    versioned_vector() : current(new version()) {}
+
+    explicit versioned_vector(vector<T> const &initial)
+            : current(new version(initial)) {}
+
+    versioned_vector(versioned_vector const &) = delete;
+
+    versioned_vector &operator=(versioned_vector const &) = delete;
+
+    // Not thread-safe: no load or update may run concurrently.
+    // Outstanding snapshots stay valid.
+    ~versioned_vector() {
+        release_owner(current.load(std::memory_order_relaxed));
+    }
+
+    snapshot load() const {
+        epoch_domain::guard g(epoch_domain::global());
+        version *v = current.load();
+        v->references.acquire(g);
+        return snapshot(v);
+    }
+
+    // Calls fn(vector<T> &) on a copy of the current contents and publishes
+    // the result. If fn throws, nothing is published.
+    template<typename F>
+    void update(F &&fn) {
+        std::lock_guard<std::mutex> lock(writer);
+        version *old = current.load(std::memory_order_relaxed);
+        auto next = std::make_unique<version>(old->data);
+        fn(next->data);
+        current.store(next.release());
+        release_owner(old);
+    }
+
+private:
+    std::atomic<version *> current;
+    std::mutex writer;
+
+    static void release_owner(version *v) {
+        if (v->references.release_owner()) {
+            delete v;
+        }
+    }
+};
+
+#endif //VECTOR_VERSIONED_VECTOR_H
@@ -0,0 +1,95 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "counted.h"
+#include "versioned_vector.h"
+
+TEST(versioned_vector, snapshot_isolation)
+{
+    versioned_vector<int> v;
+    EXPECT_TRUE(v.load()->empty());
+
+    v.update([](vector<int>& data)
+             {
+                 data.push_back(1);
+                 data.push_back(2);
+             });
+    auto before = v.load();
+    v.update([](vector<int>& data)
+             {
+                 data[0] = 10;
+                 data.push_back(3);
+             });
+    auto after = v.load();
+
+    ASSERT_EQ(2u, before->size());
+    EXPECT_EQ(1, (*before)[0]);
+    ASSERT_EQ(3u, after->size());
+    EXPECT_EQ(10, (*after)[0]);
+    EXPECT_EQ(3, (*after)[2]);
+}
+
+TEST(versioned_vector, failed_update_publishes_nothing)
+{
+    counted::no_new_instances_guard g;
+    {
+        vector<counted> initial;
+        initial.push_back(1);
+        initial.push_back(2);
+        versioned_vector<counted> v(initial);
+        auto before = v.load();
+
+        EXPECT_THROW(v.update([](vector<counted>& data)
+                              {
+                                  data.push_back(3);
+                                  throw std::runtime_error("rejected");
+                              }), std::runtime_error);
+
+        auto after = v.load();
+        EXPECT_EQ(&(*before)[0], &(*after)[0]);
+        EXPECT_EQ(2u, after->size());
+    }
+    g.expect_no_instances();
+}
+
+TEST(versioned_vector, concurrent_readers)
+{
+    const int readers = 4;
+    const int updates = 200;
+    versioned_vector<int> v;
+    std::atomic<bool> done(false);
+    std::atomic<size_t> loads(0);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t != readers; ++t)
+        threads.emplace_back([&]
+                             {
+                                 while (!done)
+                                 {
+                                     auto s = v.load();
+                                     // every version holds size() copies of its size
+                                     for (size_t i = 0; i != s->size(); ++i)
+                                         ASSERT_EQ(static_cast<int>(s->size()), (*s)[i]);
+                                     ++loads;
+                                 }
+                             });
+
+    while (loads == 0)
+        std::this_thread::yield();
+    for (int i = 1; i <= updates; ++i)
+        v.update([i](vector<int>& data)
+                 {
+                     data.push_back(0);
+                     for (size_t j = 0; j != data.size(); ++j)
+                         data[j] = i;
+                 });
+    done = true;
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(static_cast<size_t>(updates), v.load()->size());
+    EXPECT_NE(0u, loads.load());
+}
@@ -0,0 +1,200 @@
+#ifndef VECTOR_WORK_STEALING_POOL_H
+#define VECTOR_WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool with one task deque per worker.
+// A worker pushes and pops its own tasks at the back and steals from the
+// front of the other deques when it runs dry. Tasks submitted from outside
+// the pool are spread round-robin. wait() lets the calling thread help until
+// every submitted task has finished, and rethrows the first exception a task
+// let escape. Tasks must not call wait() themselves; is_worker() tells them
+// apart. try_claim() lets callers that share a pool take turns.
+class work_stealing_pool {
+public:
+    typedef std::function<void()> task;
+
+    explicit work_stealing_pool(size_t threads = std::thread::hardware_concurrency())
+            : queues(threads == 0 ? 1 : threads) {
+        for (auto &q : queues) {
+            q = std::make_unique<task_queue>();
+        }
+        for (size_t i = 0; i != threads; ++i) {
+            workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    work_stealing_pool(work_stealing_pool const &) = delete;
+
+    work_stealing_pool &operator=(work_stealing_pool const &) = delete;
+
+    ~work_stealing_pool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake_workers.notify_all();
+        for (auto &w : workers) {
+            w.join();
+        }
+    }
+
+    size_t size() const noexcept {
+        return workers.size();
+    }
+
+    // Whether the calling thread is one of this pool's workers.
+    bool is_worker() const noexcept {
+        return current.pool == this;
+    }
+
+    // Makes the caller the only one submitting and waiting until
+    // release_claim(); false if another caller holds the pool.
+    bool try_claim() noexcept {
+        return !claimed.exchange(true, std::memory_order_acquire);
+    }
+
+    void release_claim() noexcept {
+        claimed.store(false, std::memory_order_release);
+    }
+
+    // If this throws, t was not queued.
+    void submit(task t) {
+        size_t index = current.pool == this ? current.index : next_queue++ % queues.size();
+        unfinished++;
+        try {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(t));
+        } catch (...) {
+            unfinished--;
+            throw;
+        }
+        queued++;
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        wake_workers.notify_one();
+        wake_waiter.notify_one();
+    }
+
+    void wait() {
+        for (;;) {
+            task t;
+            if (take(current.pool == this ? current.index : 0, t)) {
+                run(t);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake_waiter.wait(lock, [this] { return unfinished == 0 || queued != 0; });
+            if (unfinished == 0) {
+                break;
+            }
+        }
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            std::swap(error, first_error);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    struct worker_identity {
+        work_stealing_pool *pool = nullptr;
+        size_t index = 0;
+    };
+
+    static thread_local worker_identity current;
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> unfinished{0};
+    std::atomic<bool> claimed{false};
+    std::mutex sleep_mutex;
+    std::condition_variable wake_workers;
+    std::condition_variable wake_waiter;
+    bool stopping = false;
+    std::exception_ptr first_error;
+
+    bool take(size_t own, task &t) {
+        if (queued == 0) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[own]->mutex);
+            if (!queues[own]->tasks.empty()) {
+                t = std::move(queues[own]->tasks.back());
+                queues[own]->tasks.pop_back();
+                queued--;
+                return true;
+            }
+        }
+        for (size_t i = 1; i != queues.size(); ++i) {
+            auto &victim = *queues[(own + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                t = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(task &t) {
+        try {
+            t();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            if (!first_error) {
+                first_error = std::current_exception();
+            }
+        }
+        t = nullptr;
+        if (--unfinished == 0) {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+            }
+            wake_waiter.notify_all();
+        }
+    }
+
+    void work(size_t index) {
+        current.pool = this;
+        current.index = index;
+        for (;;) {
+            task t;
+            if (take(index, t)) {
+                run(t);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake_workers.wait(lock, [this] { return stopping || queued != 0; });
+            if (stopping) {
+                break;
+            }
+        }
+    }
+};
+
+inline thread_local work_stealing_pool::worker_identity work_stealing_pool::current;
+
+#endif //VECTOR_WORK_STEALING_POOL_H